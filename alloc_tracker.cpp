@@ -0,0 +1,118 @@
+#include "alloc_tracker.h"
+
+#include <cstdlib>
+#include <new>
+
+#include <foundation/format.h>
+#include <foundation/log.h>
+
+#if _DEBUG && defined(_WIN32)
+#define ALLOC_TRACKER_SITES 1
+#include <windows.h>
+
+#include <dbghelp.h>
+#endif
+
+static thread_local AllocStats thread_alloc_stats;
+
+AllocStats GetThreadAllocStats() { return thread_alloc_stats; }
+
+//
+#if ALLOC_TRACKER_SITES
+constexpr int site_depth = 8, max_site_count = 256;
+
+struct AllocSite {
+	void *frames[site_depth];
+	uint32_t hash, count;
+	uint64_t bytes;
+};
+
+static AllocSite sites[max_site_count]; // fixed storage, recording must not allocate
+static int site_count;
+static thread_local bool capture_sites, in_capture;
+
+static void RecordAllocSite(size_t size) {
+	in_capture = true;
+
+	void *frames[site_depth + 2];
+	ULONG hash;
+	auto depth = CaptureStackBackTrace(2, site_depth, frames, &hash); // skip the tracker and operator new
+
+	int i = 0;
+	for (; i < site_count; ++i)
+		if (sites[i].hash == hash)
+			break;
+
+	if (i == site_count && site_count < max_site_count) {
+		auto &site = sites[site_count++];
+		for (int j = 0; j < site_depth; ++j)
+			site.frames[j] = j < depth ? frames[j] : nullptr;
+		site.hash = hash;
+	}
+
+	if (i < max_site_count) {
+		++sites[i].count;
+		sites[i].bytes += size;
+	}
+
+	in_capture = false;
+}
+
+void SetAllocSiteCapture(bool enable) { capture_sites = enable; }
+
+void DumpAllocSites(size_t max_sites) {
+	capture_sites = false;
+
+	auto process = GetCurrentProcess();
+	SymInitialize(process, nullptr, TRUE);
+
+	for (size_t n = 0; n < max_sites; ++n) {
+		AllocSite *top = nullptr;
+		for (int i = 0; i < site_count; ++i)
+			if (sites[i].count && (!top || sites[i].count > top->count))
+				top = &sites[i];
+		if (!top)
+			break;
+
+		hg::log(hg::format("Alloc site: %1 allocations, %2 bytes").arg(top->count).arg(top->bytes));
+
+		char buffer[sizeof(SYMBOL_INFO) + 256];
+		auto symbol = reinterpret_cast<SYMBOL_INFO *>(buffer);
+		symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+		symbol->MaxNameLen = 255;
+
+		for (int j = 0; j < site_depth && top->frames[j]; ++j)
+			if (SymFromAddr(process, DWORD64(top->frames[j]), nullptr, symbol))
+				hg::log(hg::format("    %1").arg(symbol->Name));
+
+		top->count = 0;
+	}
+
+	site_count = 0;
+}
+#else
+void SetAllocSiteCapture(bool) {}
+void DumpAllocSites(size_t) {}
+#endif
+
+//
+static void *TrackedAlloc(size_t size) {
+	++thread_alloc_stats.count;
+	thread_alloc_stats.bytes += size;
+
+#if ALLOC_TRACKER_SITES
+	if (capture_sites && !in_capture)
+		RecordAllocSite(size);
+#endif
+
+	if (auto p = malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void *operator new(size_t size) { return TrackedAlloc(size); }
+void *operator new[](size_t size) { return TrackedAlloc(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
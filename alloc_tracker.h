@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Heap allocation counters, tracked per thread by the global operator new.
+struct AllocStats {
+	uint64_t count{0};
+	uint64_t bytes{0};
+
+	AllocStats &operator+=(const AllocStats &o) {
+		count += o.count;
+		bytes += o.bytes;
+		return *this;
+	}
+};
+
+inline AllocStats operator-(const AllocStats &a, const AllocStats &b) { return {a.count - b.count, a.bytes - b.bytes}; }
+
+/// Allocations made by the calling thread since it started.
+AllocStats GetThreadAllocStats();
+
+/// Accumulate the allocations made by the calling thread during the scope lifetime.
+class AllocScope {
+public:
+	explicit AllocScope(AllocStats &acc) : acc(acc), start(GetThreadAllocStats()) {}
+	~AllocScope() { acc += GetThreadAllocStats() - start; }
+
+private:
+	AllocStats &acc;
+	AllocStats start;
+};
+
+/// Record the call stack of allocations made by the calling thread (debug builds only).
+void SetAllocSiteCapture(bool enable);
+/// Log the most frequent recorded call sites and clear them.
+void DumpAllocSites(size_t max_sites = 8);
@@ -0,0 +1,364 @@
+#include "batch_env.h"
+#include "det_math.h"
+#include "gameplay.h"
+
+namespace {
+constexpr int D = batch_env_drone_count, S = batch_env_shot_slots;
+constexpr float alien_x = width / 2.f, alien_y = 0.f;
+
+int SeqAt(uint8_t seq, int i) { return (seq >> (i * 2)) & 3; }
+} // namespace
+
+BatchEnv::BatchEnv(int env_count_, uint32_t seed, int max_steps_) : env_count(env_count_ > 0 ? env_count_ : 1), max_steps(max_steps_) {
+	auto M = size_t(env_count);
+
+	for (auto v : {&px, &py, &vx, &vy, &angle})
+		v->resize(D * M);
+	for (auto v : {&sx, &sy, &svx, &svy})
+		v->resize(S * M);
+	for (auto v : {&shot_state, &shot_seq_idx, &shot_seq})
+		v->resize(S * M);
+	for (auto v : {&human_health, &alien_health, &steps, &next_spawn})
+		v->resize(M);
+
+	rng.resize(M);
+	for (size_t e = 0; e < M; ++e)
+		rng[e] = (seed + uint32_t(e)) * 2654435761u | 1; // xorshift state must not be 0
+
+	Reset(nullptr);
+}
+
+uint32_t BatchEnv::Rand(int e) { // xorshift32, one stream per env so that envs do not depend on each other
+	auto x = rng[e];
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return rng[e] = x;
+}
+
+void BatchEnv::ResetEnv(int e) {
+	auto M = env_count;
+
+	for (int d = 0; d < D; ++d) { // same spread as GameInit
+		auto i = d * M + e;
+		px[i] = FRand(e, 100, 620);
+		py[i] = FRand(e, 400, 800);
+		vx[i] = FRand(e, -0.1f, 0.1f);
+		vy[i] = FRand(e, -0.1f, 0.1f);
+		angle[i] = FRand(e, 0, 6.2831853f);
+	}
+
+	for (int s = 0; s < S; ++s)
+		shot_state[s * M + e] = ShotFree;
+
+	human_health[e] = 100;
+	alien_health[e] = 100;
+	steps[e] = 0;
+	next_spawn[e] = StepsFromSec(first_shoot_delay);
+}
+
+void BatchEnv::Reset(float *obs) {
+	for (int e = 0; e < env_count; ++e)
+		ResetEnv(e);
+	if (obs)
+		Observe(obs);
+}
+
+//
+void BatchEnv::ApplyActions(const float *angles, const uint8_t *fires) {
+	auto M = env_count;
+
+	for (int d = 0; d < D; ++d)
+		for (int e = 0; e < M; ++e)
+			angle[d * M + e] = angles[e * D + d];
+
+	for (int e = 0; e < M; ++e)
+		for (int d = 0; d < D; ++d) {
+			if (!fires[e * D + d])
+				continue;
+
+			for (int s = 0; s < S; ++s) { // first held shot, as PlayerFireShot on GetPlayerShoots(idx)[0]
+				auto j = s * M + e;
+				if (shot_state[j] != ShotHeld || SeqAt(shot_seq[j], shot_seq_idx[j]) != d)
+					continue;
+
+				auto i = d * M + e;
+				float dx, dy;
+				DetSinCos(angle[i], dy, dx);
+
+				sx[j] = px[i] + dx * player_radius; // prevent self collision
+				sy[j] = py[i] + dy * player_radius;
+				svx[j] = dx * shoot_speed;
+				svy[j] = dy * shoot_speed;
+				shot_state[j] = ShotFlying;
+				shot_seq_idx[j]++;
+
+				vx[i] += svx[j] * player_decoy_coef;
+				vy[i] += svy[j] * player_decoy_coef;
+				break;
+			}
+		}
+}
+
+void BatchEnv::CollidePlayers() {
+	auto M = env_count;
+	constexpr float r2 = player_radius * 2;
+
+	// UpdatePlayersCollision visits each pair in both orders, positions do not move in between so this is twice the impulse
+	for (int a = 0; a < D; ++a)
+		for (int b = a + 1; b < D; ++b) {
+			auto pax = &px[a * M], pay = &py[a * M], pbx = &px[b * M], pby = &py[b * M];
+			auto vax = &vx[a * M], vay = &vy[a * M], vbx = &vx[b * M], vby = &vy[b * M];
+
+			for (int e = 0; e < M; ++e) {
+				auto dx = pbx[e] - pax[e], dy = pby[e] - pay[e];
+				auto l = DetSqrt(dx * dx + dy * dy);
+				auto k = l < r2 && l > 0.f ? 2.f * (r2 - l) * player_to_player_collision_damping / l : 0.f;
+
+				vbx[e] += dx * k;
+				vby[e] += dy * k;
+				vax[e] -= dx * k;
+				vay[e] -= dy * k;
+			}
+		}
+}
+
+void BatchEnv::CollidePlayfield() {
+	constexpr auto pad = playfield_padding + player_radius;
+	constexpr float min_x = pad, max_x = width - pad, min_y = pad * 3.5f, max_y = height - pad * 3.5f;
+	constexpr float bounce = -player_to_wall_collision_damping;
+
+	auto n = D * env_count;
+	for (int i = 0; i < n; ++i) {
+		auto x = px[i], y = py[i], spd_x = vx[i], spd_y = vy[i];
+		vx[i] = (x > max_x && spd_x > 0) || (x < min_x && spd_x < 0) ? spd_x * bounce : spd_x;
+		vy[i] = (y > max_y && spd_y > 0) || (y < min_y && spd_y < 0) ? spd_y * bounce : spd_y;
+	}
+}
+
+void BatchEnv::IntegratePlayers() {
+	auto n = D * env_count;
+	for (int i = 0; i < n; ++i) {
+		px[i] += vx[i];
+		py[i] += vy[i];
+		vx[i] *= player_damping;
+		vy[i] *= player_damping;
+	}
+}
+
+void BatchEnv::SpawnShots() {
+	auto M = env_count;
+
+	for (int e = 0; e < M; ++e) {
+		if (--next_spawn[e] > 0)
+			continue;
+
+		next_spawn[e] = StepsFromSec(FRand(e, shoot_spawn_min_delay, shoot_spawn_max_delay));
+
+		int s = 0;
+		while (s < S && shot_state[s * M + e] != ShotFree)
+			++s;
+		if (s == S)
+			continue;
+
+		int seq[4] = {0, 1, 2, 3}; // same shuffle as InitShoot
+		for (int i = 0; i < 4; ++i) {
+			int a = Rand(e) & 3, b = Rand(e) & 3;
+			auto tmp = seq[a];
+			seq[a] = seq[b];
+			seq[b] = tmp;
+		}
+
+		auto j = s * M + e;
+		shot_seq[j] = uint8_t(seq[0] | seq[1] << 2 | seq[2] << 4 | seq[3] << 6);
+		shot_seq_idx[j] = 0;
+		shot_state[j] = ShotFlying;
+		sx[j] = alien_x;
+		sy[j] = alien_y;
+
+		auto i = seq[0] * M + e;
+		auto dx = px[i] - sx[j], dy = py[i] - sy[j];
+		auto l = DetSqrt(dx * dx + dy * dy);
+		auto k = l > 0.f ? shoot_speed / l : 0.f;
+		svx[j] = dx * k;
+		svy[j] = dy * k;
+	}
+}
+
+void BatchEnv::UpdateShots(float *rewards) {
+	auto M = env_count;
+	constexpr float hit_r = shoot_radius + player_radius;
+
+	for (int s = 0; s < S; ++s)
+		for (int e = 0; e < M; ++e) {
+			auto j = s * M + e;
+			if (shot_state[j] != ShotFlying)
+				continue;
+
+			auto dx = svx[j], dy = svy[j];
+			int seq_idx = shot_seq_idx[j];
+
+			// swept capture by the next drone in the sequence, see SweptCircleHit
+			float t = 2.f;
+			if (seq_idx < 4) {
+				auto i = SeqAt(shot_seq[j], seq_idx) * M + e;
+				auto fx = sx[j] - px[i], fy = sy[j] - py[i];
+				auto c = fx * fx + fy * fy - hit_r * hit_r;
+				auto a = dx * dx + dy * dy, b = fx * dx + fy * dy;
+				auto disc = b * b - a * c;
+
+				if (c < 0.f)
+					t = 0.f;
+				else if (a > 0.f && b < 0.f && disc >= 0.f)
+					t = (-b - DetSqrt(disc)) / a;
+
+				if (t <= 1.f) {
+					shot_state[j] = ShotHeld;
+					vx[i] += dx * shoot_to_player_transfer_coef;
+					vy[i] += dy * shoot_to_player_transfer_coef;
+				}
+			}
+
+			if (t > 1.f)
+				t = 1.f;
+			auto x = sx[j] += dx * t, y = sy[j] += dy * t;
+
+			bool could_hit_alien = false, out_of_bound = false;
+			if (x < -shoot_radius || x > width + shoot_radius || y > height + shoot_radius)
+				out_of_bound = true;
+			else if (y < -shoot_radius)
+				could_hit_alien = out_of_bound = true;
+
+			if (!out_of_bound)
+				continue;
+
+			if (seq_idx == 4) { // last human shot
+				if (could_hit_alien) {
+					alien_health[e] -= alien_hit_damage;
+					rewards[e] += alien_hit_damage;
+				} else {
+					human_health[e] -= alien_miss_damage;
+					rewards[e] -= alien_miss_damage;
+				}
+			} else if (seq_idx > 0) { // chain break, an initial alien shot leaving the field is harmless
+				human_health[e] -= chain_break_damage;
+				rewards[e] -= chain_break_damage;
+			}
+
+			shot_state[j] = ShotFree;
+		}
+}
+
+//
+void BatchEnv::Observe(float *obs) const {
+	auto M = env_count;
+
+	for (int e = 0; e < M; ++e) {
+		auto o = obs + size_t(e) * batch_env_obs_size;
+
+		for (int d = 0; d < D; ++d, o += batch_env_drone_obs_size) {
+			auto i = d * M + e;
+
+			int held = 0;
+			float tgt_x = 0, tgt_y = 0;
+
+			for (int s = 0; s < S; ++s) {
+				auto j = s * M + e;
+				if (shot_state[j] != ShotHeld || SeqAt(shot_seq[j], shot_seq_idx[j]) != d)
+					continue;
+
+				if (held++ == 0) {
+					auto next = shot_seq_idx[j] + 1;
+					if (next == 4) {
+						tgt_x = alien_x;
+						tgt_y = alien_y;
+					} else {
+						auto k = SeqAt(shot_seq[j], next) * M + e;
+						tgt_x = px[k];
+						tgt_y = py[k];
+					}
+				}
+			}
+
+			// positions are normalized to the playfield, speeds to the shot speed
+			o[0] = px[i] / width;
+			o[1] = py[i] / height;
+			o[2] = vx[i] / shoot_speed;
+			o[3] = vy[i] / shoot_speed;
+			DetSinCos(angle[i], o[5], o[4]);
+			o[6] = float(held);
+			o[7] = held ? tgt_x / width : 0.f;
+			o[8] = held ? tgt_y / height : 0.f;
+		}
+
+		o[0] = human_health[e] / 100.f;
+		o[1] = alien_health[e] / 100.f;
+	}
+}
+
+int BatchEnv::GetShotCount(int env) const {
+	int count = 0;
+	for (int s = 0; s < S; ++s)
+		if (shot_state[s * env_count + env] != ShotFree)
+			++count;
+	return count;
+}
+
+void BatchEnv::Step(const float *angles, const uint8_t *fires, float *obs, float *rewards, uint8_t *dones) {
+	for (int e = 0; e < env_count; ++e)
+		rewards[e] = 0;
+
+	// same order as UpdatePlayersInputs + GameTick
+	ApplyActions(angles, fires);
+	CollidePlayers();
+	CollidePlayfield();
+	IntegratePlayers();
+	SpawnShots();
+	UpdateShots(rewards);
+
+	for (int e = 0; e < env_count; ++e) {
+		auto done = human_health[e] <= 0 || alien_health[e] <= 0 || ++steps[e] >= max_steps;
+		dones[e] = done;
+		if (done)
+			ResetEnv(e);
+	}
+
+	if (obs)
+		Observe(obs);
+}
+
+void BatchEnv::ScriptedActions(int env_count, const float *obs, float *angles, uint8_t *fires) {
+	for (int e = 0; e < env_count; ++e)
+		for (int d = 0; d < D; ++d) {
+			auto o = obs + size_t(e) * batch_env_obs_size + d * batch_env_drone_obs_size;
+			auto a = e * D + d;
+			fires[a] = o[6] > 0;
+			if (fires[a])
+				angles[a] = DetAtan2((o[8] - o[1]) * height, (o[7] - o[0]) * width);
+		}
+}
+
+uint32_t BatchEnv::Checksum(int env_count, int step_count) {
+	BatchEnv env(env_count, 1);
+
+	std::vector<float> angles(env_count * D), obs(env_count * batch_env_obs_size), rewards(env_count);
+	std::vector<uint8_t> fires(env_count * D), dones(env_count);
+
+	env.Reset(obs.data());
+
+	uint32_t hash = 2166136261u;
+	for (int i = 0; i < step_count; ++i) {
+		ScriptedActions(env_count, obs.data(), angles.data(), fires.data());
+		env.Step(angles.data(), fires.data(), obs.data(), rewards.data(), dones.data());
+		hash = DetHash(hash, obs.data(), obs.size());
+		hash = DetHash(hash, rewards.data(), rewards.size());
+	}
+	return hash;
+}
+
+//
+BatchEnv *batch_env_create(int env_count, uint32_t seed, int max_steps) { return new BatchEnv(env_count, seed, max_steps); }
+void batch_env_destroy(BatchEnv *env) { delete env; }
+void batch_env_reset(BatchEnv *env, float *obs) { env->Reset(obs); }
+void batch_env_step(BatchEnv *env, const float *angles, const uint8_t *fires, float *obs, float *rewards, uint8_t *dones) { env->Step(angles, fires, obs, rewards, dones); }
+int batch_env_get_obs_size() { return batch_env_obs_size; }
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Batched training environment: M independent matches stepped in lockstep at
+// the 60Hz reference rate, with the game rules and constants of main.cpp but
+// no rendering, audio or AI. Each of the 4 drones is driven by the same
+// actions as a human player: an aiming angle and a fire button.
+//
+// State is stored as structure of arrays indexed [slot * env_count + env] so
+// that every update is a flat loop over the environments.
+constexpr int batch_env_drone_count = 4;
+constexpr int batch_env_shot_slots = 16; // a spawn is skipped while all slots are in use
+
+// observation per drone: x, y, vx, vy, cos/sin angle, held shots, next target x, y
+constexpr int batch_env_drone_obs_size = 9;
+// observation per env: all drones followed by the human and alien health
+constexpr int batch_env_obs_size = batch_env_drone_count * batch_env_drone_obs_size + 2;
+
+class BatchEnv {
+public:
+	BatchEnv(int env_count, uint32_t seed, int max_steps = 60 * 60 * 5);
+
+	int GetEnvCount() const { return env_count; }
+
+	/// Reset all environments, obs receives env_count * batch_env_obs_size floats (may be null).
+	void Reset(float *obs);
+
+	/// Advance all environments by one step.
+	/// angles and fires hold env_count * batch_env_drone_count values, environment major.
+	/// A drone fires the first shot it holds when its fire value is not 0.
+	/// The reward is the damage dealt to the alien minus the damage taken by the humans.
+	/// Finished environments are reset, obs then holds the first observation of the next match.
+	void Step(const float *angles, const uint8_t *fires, float *obs, float *rewards, uint8_t *dones);
+
+	void Observe(float *obs) const;
+	int GetShotCount(int env) const;
+
+	/// Drones firing their held shots straight at the next target, for benchmarks and checks.
+	static void ScriptedActions(int env_count, const float *obs, float *angles, uint8_t *fires);
+	/// Hash of the observations and rewards of scripted matches, identical across builds.
+	static uint32_t Checksum(int env_count, int step_count);
+
+private:
+	void ResetEnv(int e);
+
+	void ApplyActions(const float *angles, const uint8_t *fires);
+	void CollidePlayers();
+	void CollidePlayfield();
+	void IntegratePlayers();
+	void SpawnShots();
+	void UpdateShots(float *rewards);
+
+	uint32_t Rand(int e);
+	float FRand(int e, float lo, float hi) { return lo + (hi - lo) * float(Rand(e) >> 8) * (1.f / 16777216.f); }
+
+	int env_count, max_steps;
+
+	// drones [drone * env_count + env]
+	std::vector<float> px, py, vx, vy, angle;
+
+	// shots [slot * env_count + env]
+	enum ShotState : uint8_t { ShotFree, ShotFlying, ShotHeld };
+	std::vector<float> sx, sy, svx, svy;
+	std::vector<uint8_t> shot_state, shot_seq_idx;
+	std::vector<uint8_t> shot_seq; // 2 bits per sequence entry
+
+	// per env
+	std::vector<int> human_health, alien_health, steps, next_spawn;
+	std::vector<uint32_t> rng;
+};
+
+#if defined(_WIN32)
+#define BATCH_ENV_API extern "C" __declspec(dllexport)
+#else
+#define BATCH_ENV_API extern "C" __attribute__((visibility("default")))
+#endif
+
+// C API for bindings (eg. Python ctypes against the tako_env shared library)
+BATCH_ENV_API BatchEnv *batch_env_create(int env_count, uint32_t seed, int max_steps);
+BATCH_ENV_API void batch_env_destroy(BatchEnv *env);
+BATCH_ENV_API void batch_env_reset(BatchEnv *env, float *obs);
+BATCH_ENV_API void batch_env_step(BatchEnv *env, const float *angles, const uint8_t *fires, float *obs, float *rewards, uint8_t *dones);
+BATCH_ENV_API int batch_env_get_obs_size();
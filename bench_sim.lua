@@ -0,0 +1,332 @@
+-- Simulation benchmark: pure Lua ticks (port of main.lua) against native ticks
+-- through the tako module. Run with: ggj2018 -bench-lua bench_sim.lua
+--
+-- The Lua tick follows GameTick: collisions, AI, captures, alien and earth
+-- hits, health, spawns on whole steps, and the FX, messages and shakes they
+-- trigger. Those are only recorded, as in the native headless ticks. Sounds
+-- and telemetry are left out.
+tako = require("tako")
+
+width = 720
+height = 1280
+playfield_padding = 50
+
+player_damping = 0.999
+player_radius = 50
+player_to_player_collision_damping = 0.5
+player_to_wall_collision_damping = 0.5
+
+player_decoy_coef = -0.075
+shoot_to_player_transfer_coef = 0.125
+
+shoot_radius = 20
+shoot_speed = 40
+shoot_hold_duration = 4
+
+ai_min_delay = 0.5
+ai_max_delay = 2.5
+ai_precision_delta = math.rad(5)
+ai_aiming_speed = 0.1
+
+first_shoot_delay = 3
+shoot_spawn_min_delay = 1
+shoot_spawn_max_delay = 3.5
+
+alien_hit_damage = 5
+alien_miss_damage = 10
+chain_break_damage = 5
+
+bench_ticks = 200000
+bench_dt = 1 / 60
+
+-- hg.Vector2 is not available outside of the harfang runtime, this stand-in
+-- allocates a new object per operation the same way
+Vector2 = {}
+Vector2.__index = Vector2
+
+function Vector2.new(x, y)
+    return setmetatable({x = x, y = y}, Vector2)
+end
+
+Vector2.__add = function(a, b) return Vector2.new(a.x + b.x, a.y + b.y) end
+Vector2.__sub = function(a, b) return Vector2.new(a.x - b.x, a.y - b.y) end
+Vector2.__mul = function(a, k) return Vector2.new(a.x * k, a.y * k) end
+
+function Vector2:Len()
+    return math.sqrt(self.x * self.x + self.y * self.y)
+end
+
+function Vector2:Normalized()
+    local l = self:Len()
+    return Vector2.new(self.x / l, self.y / l)
+end
+
+function Vector2.Dist(a, b)
+    return (b - a):Len()
+end
+
+function FRRand(min, max)
+    return min + math.random() * (max - min)
+end
+
+function AngleToDirection(angle)
+    angle = -angle + math.rad(90)
+    return Vector2.new(math.sin(angle), math.cos(angle))
+end
+
+function StepsFromSec(sec)
+    return math.floor(sec * 60 + 0.5)
+end
+
+-- presentation is recorded the way the native tick does, it is drawn by nobody
+function SpawnFX(x, y, img, size, rotation, duration, delay, alpha, size_spd)
+    fxs[#fxs + 1] = {pos = Vector2.new(x, y), img = img, size = size, rotation = rotation, duration = duration, delay = delay, alpha = alpha, size_spd = size_spd}
+end
+
+function SpawnBloodSplatFX(pos, path)
+    for i = 1, 3 do
+        SpawnFX(pos.x + FRRand(-width * 0.5, width * 0.5), pos.y + FRRand(-20, 20), path, FRRand(200, 600), FRRand(0, 2), 1, FRRand(0, 1), 1, 0)
+    end
+end
+
+function SetMessage(target, msg)
+    target.msg = msg
+    target.msg_delay = 2
+end
+
+function GetAlienPos()
+    local offset = FRRand(-4, 4)
+    return Vector2.new(width / 2 + offset, 60 + offset)
+end
+
+function GetEarthPos()
+    return Vector2.new(width / 2, height - 120)
+end
+
+function GetPlayerShoots(idx)
+    local shoot_idxs = {}
+    for i, shoot in ipairs(shoots) do
+        if shoot.hold_until ~= 0 and (shoot.player_seq[shoot.player_seq_idx] == idx) then
+            table.insert(shoot_idxs, i)
+        end
+    end
+    return shoot_idxs
+end
+
+function PlayerFireShot(player_idx, idx)
+    local player = players[player_idx]
+    local shoot = shoots[idx]
+
+    local dir = AngleToDirection(player.angle)
+    shoot.pos = player.pos + dir * player_radius
+    shoot.spd = dir * shoot_speed
+    shoot.hold_until = 0
+    player.spd = player.spd + (shoot.spd * player_decoy_coef)
+    shoot.player_seq_idx = shoot.player_seq_idx + 1
+end
+
+function GetShootNextTargetPos(shot)
+    if (shot.player_seq_idx + 1) == 5 then
+        return Vector2.new(width / 2, 0)
+    end
+    return players[shot.player_seq[shot.player_seq_idx + 1]].pos
+end
+
+function UpdatePlayer(idx)
+    local player = players[idx]
+
+    player.pos = player.pos + player.spd
+    player.spd = player.spd * player_damping
+
+    local shots = GetPlayerShoots(idx)
+
+    if #shots > 0 then
+        local shot = shoots[shots[1]]
+        local dir = (GetShootNextTargetPos(shot) - player.pos):Normalized()
+        player.ai_angle = math.atan(dir.y, dir.x) + FRRand(-ai_precision_delta, ai_precision_delta)
+        player.angle = player.angle + ((player.ai_angle - player.angle) * ai_aiming_speed)
+
+        player.ai_shot_delay = player.ai_shot_delay - bench_dt
+
+        if player.ai_shot_delay < 0 then
+            PlayerFireShot(idx, shots[1])
+            player.ai_shot_delay = FRRand(ai_min_delay, ai_max_delay)
+        end
+    end
+end
+
+function PlayerCollidePlayfield(player)
+    local padding = playfield_padding + player_radius
+
+    if player.pos.x > (width - padding) and player.spd.x > 0 then
+        player.spd.x = player.spd.x * -player_to_wall_collision_damping
+    end
+    if player.pos.x < padding and player.spd.x < 0 then
+        player.spd.x = player.spd.x * -player_to_wall_collision_damping
+    end
+    if player.pos.y > (height - padding * 3.5) and player.spd.y > 0 then
+        player.spd.y = player.spd.y * -player_to_wall_collision_damping
+    end
+    if player.pos.y < padding * 3.5 and player.spd.y < 0 then
+        player.spd.y = player.spd.y * -player_to_wall_collision_damping
+    end
+end
+
+function PlayerCollidePlayer(a, b)
+    local d = b.pos - a.pos
+    local l = d:Len()
+
+    if l < player_radius * 2 then
+        local v = d * ((player_radius * 2 - l) * player_to_player_collision_damping / l)
+        b.spd = b.spd + v
+        a.spd = a.spd - v
+    end
+end
+
+function UpdatePlayersCollision()
+    for i = 1, #players do
+        for j = 1, #players do
+            if i ~= j then
+                PlayerCollidePlayer(players[i], players[j])
+            end
+        end
+    end
+
+    for k, player in pairs(players) do
+        PlayerCollidePlayfield(player)
+    end
+end
+
+function SpawnShoot()
+    SetMessage(alien, "Attack!")
+    local shoot = {player_seq = {1, 2, 3, 4}, player_seq_idx = 1, hold_until = 0}
+    for i = 1, 4 do
+        local a, b = math.random(4), math.random(4)
+        shoot.player_seq[a], shoot.player_seq[b] = shoot.player_seq[b], shoot.player_seq[a]
+    end
+    shoot.pos = Vector2.new(width / 2, 0)
+    shoot.spd = (players[shoot.player_seq[1]].pos - shoot.pos):Normalized() * shoot_speed
+    table.insert(shoots, shoot)
+end
+
+function UpdateShoot(idx)
+    local shoot = shoots[idx]
+
+    if shoot.hold_until ~= 0 then
+        return false
+    end
+
+    shoot.pos = shoot.pos + shoot.spd
+
+    if shoot.player_seq_idx ~= 5 then -- only the next drone in the sequence captures the shot
+        local player = players[shoot.player_seq[shoot.player_seq_idx]]
+        if Vector2.Dist(shoot.pos, player.pos) < (shoot_radius + player_radius) then
+            shoot.hold_until = shoot_hold_duration
+            player.spd = player.spd + (shoot.spd * shoot_to_player_transfer_coef)
+            SpawnFX(player.pos.x, player.pos.y, "@data:fx_donut.png", 200, 0, 0.2, 0, 0.75, 8)
+            return false
+        end
+    end
+
+    local could_hit_alien = shoot.pos.y < -shoot_radius
+    if not (shoot.pos.x < -shoot_radius or shoot.pos.x > width + shoot_radius or could_hit_alien or shoot.pos.y > height + shoot_radius) then
+        return false
+    end
+
+    if shoot.player_seq_idx == 1 then -- initial alien shot
+        SetMessage(alien, "Human escape!")
+    elseif shoot.player_seq_idx == 5 then -- last human shot
+        local player = players[shoot.player_seq[4]]
+        if could_hit_alien then
+            SetMessage(player, "Humanity hero!")
+            SetMessage(alien, "Sufffering!")
+            SpawnBloodSplatFX(GetAlienPos(), "@data:alien_blood.png")
+            bg_shake_strength = 10
+            alien_health = alien_health - alien_hit_damage
+        else
+            SetMessage(player, "You drunkard!")
+            SetMessage(alien, "Alien missed!")
+            SetMessage(earth, "Genocide!")
+            SpawnBloodSplatFX(GetEarthPos(), "@data:human_blood.png")
+            bg_shake_strength = 10
+            human_health = human_health - alien_miss_damage
+        end
+    else
+        SetMessage(players[shoot.player_seq[shoot.player_seq_idx - 1]], "Chain breaker!")
+        SpawnBloodSplatFX(GetEarthPos(), "@data:human_blood.png")
+        SetMessage(earth, "Cataclysm!")
+        bg_shake_strength = 4
+        human_health = human_health - chain_break_damage
+    end
+    return true
+end
+
+function UpdateShoots()
+    local shoots_alive = {}
+    for i = 1, #shoots do
+        if not UpdateShoot(i) then
+            table.insert(shoots_alive, shoots[i])
+        end
+    end
+    shoots = shoots_alive
+end
+
+function LuaGameInit()
+    players = {}
+    shoots = {}
+    fxs = {}
+    alien, earth = {}, {}
+    human_health, alien_health = 100, 100
+    bg_shake_strength = 0
+    for i = 1, 4 do
+        players[i] = {pos = Vector2.new(FRRand(100, 620), FRRand(400, 800)), spd = Vector2.new(FRRand(-0.1, 0.1), FRRand(-0.1, 0.1)), angle = FRRand(0, math.rad(360)), ai_angle = 0, ai_shot_delay = FRRand(ai_min_delay, ai_max_delay)}
+    end
+    next_shoot_step = StepsFromSec(first_shoot_delay)
+end
+
+function LuaTick()
+    UpdatePlayersCollision()
+    for i = 1, #players do
+        UpdatePlayer(i)
+    end
+
+    next_shoot_step = next_shoot_step - 1 -- HeuristicSpawnShoot
+    if next_shoot_step <= 0 then
+        next_shoot_step = StepsFromSec(FRRand(shoot_spawn_min_delay, shoot_spawn_max_delay))
+        SpawnShoot()
+    end
+
+    UpdateShoots()
+end
+
+--
+function Report(name, ticks, t)
+    print(string.format("%-8s %8d ticks in %.3fs: %.0f ticks/sec", name, ticks, t, ticks / t))
+end
+
+math.randomseed(0)
+
+LuaGameInit()
+local t_start = os.clock()
+for i = 1, bench_ticks do
+    LuaTick()
+end
+local lua_t = os.clock() - t_start
+Report("lua", bench_ticks, lua_t)
+
+tako.GameInit()
+t_start = os.clock()
+for i = 1, bench_ticks, 1000 do
+    tako.Tick(bench_dt, 1000)
+end
+local native_t = os.clock() - t_start
+Report("native", bench_ticks, native_t)
+
+t_start = os.clock()
+for i = 1, bench_ticks do
+    tako.Tick(bench_dt)
+end
+local bound_t = os.clock() - t_start
+Report("bound", bench_ticks, bound_t)
+
+print(string.format("native speedup: x%.1f (x%.1f with a call per tick)", lua_t / native_t, lua_t / bound_t))
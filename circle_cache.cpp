@@ -0,0 +1,19 @@
+#include "circle_cache.h"
+#include "det_math.h"
+
+const float *CircleCache::Get(int nseg) {
+	nseg = ClampSegments(nseg);
+
+	auto &points = tessellations[nseg];
+	if (points.empty()) {
+		points.resize(size_t(nseg + 1) * 2);
+
+		auto step = 6.2831853f / float(nseg); // as Deg(360.f)
+		for (int i = 0; i < nseg; ++i)
+			DetSinCos(step * float(i), points[i * 2], points[i * 2 + 1]);
+
+		points[nseg * 2] = points[0];
+		points[nseg * 2 + 1] = points[1];
+	}
+	return points.data();
+}
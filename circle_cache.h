@@ -0,0 +1,23 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+// Unit circle tessellations per segment count, built once with the
+// deterministic sin/cos so that circles cost no trigonometry per call.
+//
+// Point 0 is at the top (0, 1) and points go clockwise, the last one closing
+// on the first.
+// No engine dependency.
+class CircleCache {
+public:
+	static constexpr int min_segments = 3, max_segments = 256;
+
+	/// nseg + 1 points as x, y pairs. nseg is clamped to [min_segments;max_segments].
+	const float *Get(int nseg);
+
+	static int ClampSegments(int nseg) { return nseg < min_segments ? min_segments : (nseg > max_segments ? max_segments : nseg); }
+
+private:
+	std::array<std::vector<float>, max_segments + 1> tessellations;
+};
@@ -0,0 +1,123 @@
+#include "det_math.h"
+
+#include <cstring>
+
+namespace {
+constexpr double pi = 3.14159265358979323846;
+
+constexpr int sin_bits = 12, sin_size = 1 << sin_bits; // entries per turn
+constexpr int atan_size = 1024; // entries over [0;1]
+
+// series evaluated in double with basic operations only
+double SeriesSin(double x) { // |x| <= pi/2
+	double x2 = x * x, term = x, sum = x;
+	for (int n = 1; n < 12; ++n) {
+		term *= -x2 / double((2 * n) * (2 * n + 1));
+		sum += term;
+	}
+	return sum;
+}
+
+double SeriesAtan(double x) { // 0 <= x <= 1
+	for (int i = 0; i < 2; ++i) // atan(x) = 2 atan(x / (1 + sqrt(1 + x²))), brings x under 0.2
+		x = x / (1.0 + std::sqrt(1.0 + x * x));
+
+	double x2 = x * x, term = x, sum = x;
+	for (int n = 1; n < 20; ++n) {
+		term *= -x2;
+		sum += term / double(2 * n + 1);
+	}
+	return sum * 4.0;
+}
+
+struct Tables {
+	float sin[sin_size + 1];
+	float atan[atan_size + 1];
+
+	Tables() {
+		for (int i = 0; i <= sin_size; ++i) { // fold the turn into [-pi/2;pi/2] so the series stays accurate
+			int q = i & (sin_size - 1);
+			double a = double(q) * (2.0 * pi / sin_size);
+			if (q > sin_size / 4 && q < sin_size * 3 / 4)
+				a = pi - a;
+			else if (q >= sin_size * 3 / 4)
+				a -= 2.0 * pi;
+			sin[i] = float(SeriesSin(a));
+		}
+
+		for (int i = 0; i <= atan_size; ++i)
+			atan[i] = float(SeriesAtan(double(i) / atan_size));
+	}
+};
+
+const Tables &GetTables() {
+	static const Tables tables;
+	return tables;
+}
+
+uint32_t AngleToTurn(float angle) { // 32 bit binary angle
+	double turns = double(angle) * (1.0 / (2.0 * pi));
+	if (std::fabs(turns) >= 1073741824.0) // keep the integer conversion in range
+		turns -= std::floor(turns);
+	return uint32_t(int64_t(turns * 4294967296.0)); // wraps to the turn
+}
+
+float SinTurn(const Tables &t, uint32_t turn) {
+	constexpr int frac_bits = 32 - sin_bits;
+	auto i = turn >> frac_bits;
+	auto f = float(turn & ((1u << frac_bits) - 1)) * (1.f / float(1u << frac_bits));
+	return t.sin[i] + (t.sin[i + 1] - t.sin[i]) * f;
+}
+
+float AtanUnit(const Tables &t, float r) { // 0 <= r <= 1
+	auto p = r * atan_size;
+	auto i = int(p);
+	if (i >= atan_size)
+		return t.atan[atan_size];
+	return t.atan[i] + (t.atan[i + 1] - t.atan[i]) * (p - float(i));
+}
+} // namespace
+
+void DetSinCos(float angle, float &s, float &c) {
+	auto &t = GetTables();
+	auto turn = AngleToTurn(angle);
+	s = SinTurn(t, turn);
+	c = SinTurn(t, turn + (1u << 30)); // cos(a) = sin(a + quarter turn)
+}
+
+float DetSin(float angle) { return SinTurn(GetTables(), AngleToTurn(angle)); }
+float DetCos(float angle) { return SinTurn(GetTables(), AngleToTurn(angle) + (1u << 30)); }
+
+float DetAtan2(float y, float x) {
+	auto ax = std::fabs(x), ay = std::fabs(y);
+	if (ax == 0.f && ay == 0.f)
+		return 0.f;
+
+	auto &t = GetTables();
+	auto a = ay <= ax ? AtanUnit(t, ay / ax) : float(pi / 2) - AtanUnit(t, ax / ay);
+
+	if (x < 0.f)
+		a = float(pi) - a;
+	return std::signbit(y) ? -a : a; // same branch cut as atan2 for -0
+}
+
+//
+uint32_t DetHash(uint32_t hash, const float *v, size_t count) {
+	for (size_t n = 0; n < count; ++n) {
+		uint32_t bits;
+		memcpy(&bits, &v[n], 4);
+		for (int i = 0; i < 4; ++i)
+			hash = (hash ^ ((bits >> (i * 8)) & 0xff)) * 16777619u;
+	}
+	return hash;
+}
+
+uint32_t DetMathChecksum() {
+	uint32_t hash = 2166136261u;
+	for (int i = -5000; i < 5000; ++i) {
+		auto a = float(i) * 0.00731f;
+		float v[4] = {DetSin(a), DetCos(a), DetAtan2(float(i % 97) - 48.f, float(i % 89) - 44.f), DetSqrt(float(i + 5000) * 0.37f)};
+		hash = DetHash(hash, v, 4);
+	}
+	return hash;
+}
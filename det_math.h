@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Deterministic math for the simulation.
+//
+// +, -, *, / and sqrt are correctly rounded by IEEE 754 and give the same
+// results everywhere as long as the compiler does not contract them into FMAs
+// or keep x87 extended precision (see the flags in CMakeLists.txt). libm
+// transcendentals have no such guarantee: sin, cos and atan2 are replaced by
+// table lookups, the tables being built from basic operations only.
+//
+// Angles are converted to a 32 bit binary angle (2^32 units per turn): the top
+// bits index the sine table and the low bits interpolate between entries.
+
+void DetSinCos(float angle, float &s, float &c);
+float DetSin(float angle);
+float DetCos(float angle);
+float DetAtan2(float y, float x);
+
+inline float DetSqrt(float v) { return std::sqrt(v); } // correctly rounded
+
+/// FNV-1a over the bit patterns of count floats, hash is 2166136261 to start a new one.
+uint32_t DetHash(uint32_t hash, const float *v, size_t count);
+
+/// Hash of a fixed sweep over the functions above, compare between builds.
+uint32_t DetMathChecksum();
@@ -0,0 +1,334 @@
+#include "draw_list.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <engine/plus.h>
+#include <engine/render_system.h>
+#include <engine/renderer.h>
+
+using namespace hg;
+
+void DrawList::Clear() {
+	cmds.clear();
+	chars.clear();
+	sounds.clear();
+	traces.clear();
+
+	line_vtx.clear();
+	line_color.clear();
+	triangle_vtx.clear();
+	triangle_color.clear();
+	line_mark = triangle_mark = 0;
+}
+
+DrawList::Cmd &DrawList::Push(CmdType type) {
+	if (line_vtx.size() != line_mark || triangle_vtx.size() != triangle_mark) { // circles recorded since the last call go under this one
+		line_mark = line_vtx.size();
+		triangle_mark = triangle_vtx.size();
+
+		cmds.emplace_back();
+		auto &cmd = cmds.back();
+		cmd.type = CmdPrimitives;
+		cmd.str[0] = uint32_t(line_mark);
+		cmd.str[1] = uint32_t(triangle_mark);
+	}
+
+	cmds.emplace_back();
+	auto &cmd = cmds.back();
+	cmd.type = type;
+	return cmd;
+}
+
+uint32_t DrawList::PushString(const char *str) {
+	auto offset = uint32_t(chars.size());
+	chars.insert(chars.end(), str, str + strlen(str) + 1);
+	return offset;
+}
+
+//
+void DrawList::Line2D(float sx, float sy, float ex, float ey, const Color &s_color, const Color &e_color) {
+	auto &cmd = Push(CmdLine);
+	cmd.v[0] = sx;
+	cmd.v[1] = sy;
+	cmd.v[2] = ex;
+	cmd.v[3] = ey;
+	cmd.c[0] = s_color;
+	cmd.c[1] = e_color;
+}
+
+void DrawList::Triangle2D(float ax, float ay, float bx, float by, float cx, float cy, const Color &a_color, const Color &b_color, const Color &c_color) {
+	auto &cmd = Push(CmdTriangle);
+	cmd.v[0] = ax;
+	cmd.v[1] = ay;
+	cmd.v[2] = bx;
+	cmd.v[3] = by;
+	cmd.v[4] = cx;
+	cmd.v[5] = cy;
+	cmd.c[0] = a_color;
+	cmd.c[1] = b_color;
+	cmd.c[2] = c_color;
+}
+
+void DrawList::Quad2D(float ax, float ay, float bx, float by, float cx, float cy, float dx, float dy, const Color &a_color, const Color &b_color, const Color &c_color, const Color &d_color) {
+	auto &cmd = Push(CmdQuad);
+	cmd.v[0] = ax;
+	cmd.v[1] = ay;
+	cmd.v[2] = bx;
+	cmd.v[3] = by;
+	cmd.v[4] = cx;
+	cmd.v[5] = cy;
+	cmd.v[6] = dx;
+	cmd.v[7] = dy;
+	cmd.c[0] = a_color;
+	cmd.c[1] = b_color;
+	cmd.c[2] = c_color;
+	cmd.c[3] = d_color;
+}
+
+void DrawList::Sprite2D(float x, float y, float size, const char *image, const Color &color) {
+	auto &cmd = Push(CmdSprite);
+	cmd.v[0] = x;
+	cmd.v[1] = y;
+	cmd.v[2] = size;
+	cmd.c[0] = color;
+	cmd.str[0] = PushString(image);
+}
+
+void DrawList::RotatedSprite2D(float x, float y, float angle, float size, const char *image, const Color &color, float pivot_x, float pivot_y) {
+	auto &cmd = Push(CmdRotatedSprite);
+	cmd.v[0] = x;
+	cmd.v[1] = y;
+	cmd.v[2] = angle;
+	cmd.v[3] = size;
+	cmd.v[4] = pivot_x;
+	cmd.v[5] = pivot_y;
+	cmd.c[0] = color;
+	cmd.str[0] = PushString(image);
+}
+
+void DrawList::Image2D(float x, float y, float scale, const char *image, const Color &color) {
+	auto &cmd = Push(CmdImage);
+	cmd.v[0] = x;
+	cmd.v[1] = y;
+	cmd.v[2] = scale;
+	cmd.c[0] = color;
+	cmd.str[0] = PushString(image);
+}
+
+void DrawList::Text2D(float x, float y, const char *text, float size, const Color &color, const char *font_path) {
+	auto &cmd = Push(CmdText);
+	cmd.v[0] = x;
+	cmd.v[1] = y;
+	cmd.v[2] = size;
+	cmd.c[0] = color;
+	cmd.str[0] = PushString(text);
+	cmd.str[1] = PushString(font_path);
+}
+
+void DrawList::Text2DCentered(float x, float y, const char *text, float size, const Color &color, const char *font_path) {
+	Text2D(x, y, text, size, color, font_path);
+	cmds.back().type = CmdTextCentered;
+}
+
+//
+void DrawList::Circle2D(float x, float y, float radius, int nseg, const Color &color) {
+	auto points = circles.Get(nseg);
+	nseg = CircleCache::ClampSegments(nseg);
+
+	for (int i = 0; i < nseg; ++i) {
+		auto p = points + i * 2;
+		line_vtx.push_back({p[0] * radius + x, p[1] * radius + y, 0.5f});
+		line_vtx.push_back({p[2] * radius + x, p[3] * radius + y, 0.5f});
+	}
+	line_color.insert(line_color.end(), size_t(nseg) * 2, color);
+}
+
+void DrawList::Disc2D(float x, float y, float radius, int nseg, const Color &color) {
+	auto points = circles.Get(nseg);
+	nseg = CircleCache::ClampSegments(nseg);
+
+	for (int i = 0; i < nseg; ++i) {
+		auto p = points + i * 2;
+		triangle_vtx.push_back({p[2] * radius + x, p[3] * radius + y, 0.5f});
+		triangle_vtx.push_back({x, y, 0.5f});
+		triangle_vtx.push_back({p[0] * radius + x, p[1] * radius + y, 0.5f});
+	}
+	triangle_color.insert(triangle_color.end(), size_t(nseg) * 3, color);
+}
+
+void DrawList::SetViewport(int x, int y, int w, int h, float view_w, float view_h) {
+	auto &cmd = Push(CmdViewport);
+	cmd.v[0] = float(x);
+	cmd.v[1] = float(y);
+	cmd.v[2] = float(w);
+	cmd.v[3] = float(h);
+	cmd.v[4] = view_w;
+	cmd.v[5] = view_h;
+}
+
+size_t DrawList::GetPrimitiveRunCount() const {
+	auto count = size_t(std::count_if(cmds.begin(), cmds.end(), [](const Cmd &cmd) { return cmd.type == CmdPrimitives; }));
+	if (line_vtx.size() != line_mark || triangle_vtx.size() != triangle_mark)
+		++count; // submitted after the last call
+	return count;
+}
+
+void DrawList::StartSound(const std::shared_ptr<Sound> &sound, MixerChannelState state) { sounds.push_back({sound.get(), state}); }
+
+//
+void DrawList::SubmitPrimitives(size_t &line_done, size_t line_end, size_t &triangle_done, size_t triangle_end) const {
+	if (line_done == line_end && triangle_done == triangle_end)
+		return;
+
+	auto &plus = g_plus.get();
+	plus.Commit2D(); // the streams go over the calls queued so far and under the ones to come
+
+	// the immediate buffer of the render system is limited, draw in chunks of whole primitives
+	constexpr size_t chunk_vtx = 6 * 2048;
+	auto &render_system = *plus.GetRenderSystem();
+
+	for (; triangle_done < triangle_end; triangle_done += std::min(chunk_vtx, triangle_end - triangle_done))
+		render_system.DrawTriangleAuto(uint32_t(std::min(chunk_vtx, triangle_end - triangle_done)), &triangle_vtx[triangle_done], &triangle_color[triangle_done]);
+	for (; line_done < line_end; line_done += std::min(chunk_vtx, line_end - line_done))
+		render_system.DrawLineAuto(uint32_t(std::min(chunk_vtx, line_end - line_done)), &line_vtx[line_done], &line_color[line_done]);
+}
+
+void DrawList::Submit() const {
+	auto &plus = g_plus.get();
+	size_t line_done = 0, triangle_done = 0;
+
+	for (auto &cmd : cmds) {
+		auto &v = cmd.v;
+		auto &c = cmd.c;
+
+		switch (cmd.type) {
+			case CmdLine:
+				plus.Line2D(v[0], v[1], v[2], v[3], c[0], c[1]);
+				break;
+			case CmdTriangle:
+				plus.Triangle2D(v[0], v[1], v[2], v[3], v[4], v[5], c[0], c[1], c[2]);
+				break;
+			case CmdQuad:
+				plus.Quad2D(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], c[0], c[1], c[2], c[3]);
+				break;
+			case CmdSprite:
+				plus.Sprite2D(v[0], v[1], v[2], &chars[cmd.str[0]], c[0]);
+				break;
+			case CmdRotatedSprite:
+				plus.RotatedSprite2D(v[0], v[1], v[2], v[3], &chars[cmd.str[0]], c[0], v[4], v[5]);
+				break;
+			case CmdImage:
+				plus.Image2D(v[0], v[1], v[2], &chars[cmd.str[0]], c[0]);
+				break;
+			case CmdText:
+				plus.Text2D(v[0], v[1], &chars[cmd.str[0]], v[2], c[0], &chars[cmd.str[1]]);
+				break;
+			case CmdTextCentered: {
+				auto text = &chars[cmd.str[0]], font_path = &chars[cmd.str[1]];
+				auto rect = plus.GetTextRect(text, v[2], font_path);
+				plus.Text2D(v[0] - rect.GetWidth() / 2, v[1] + rect.GetHeight() / 2, text, v[2], c[0], font_path);
+			} break;
+			case CmdViewport:
+				plus.Commit2D();
+				plus.GetRenderer()->SetViewport(fRect(v[0], v[1], v[0] + v[2], v[1] + v[3]));
+				plus.GetRenderSystem()->SetView2D(0, 0, v[4], v[5]);
+				break;
+			case CmdPrimitives:
+				SubmitPrimitives(line_done, cmd.str[0], triangle_done, cmd.str[1]);
+				break;
+		}
+	}
+
+	SubmitPrimitives(line_done, line_vtx.size(), triangle_done, triangle_vtx.size());
+
+	auto mixer = plus.GetMixer();
+	for (auto &sound : sounds)
+		mixer->Start(*sound.sound, sound.state);
+}
+
+namespace {
+SoftColor ToSoft(const Color &c) { return {c.r, c.g, c.b, c.a}; }
+
+// quad of a w x h image with its pivot at x, y, rotated by angle around it
+void SpriteQuad(float x, float y, float angle, float w, float h, float pivot_x, float pivot_y, float *xy) {
+	const float corners[8] = {0, 0, 0, 1, 1, 1, 1, 0}; // bottom-left, top-left, top-right, bottom-right
+	auto c = std::cos(angle), s = std::sin(angle);
+
+	for (int i = 0; i < 4; ++i) {
+		auto lx = (corners[i * 2] - pivot_x) * w, ly = (corners[i * 2 + 1] - pivot_y) * h;
+		xy[i * 2] = x + lx * c - ly * s;
+		xy[i * 2 + 1] = y + lx * s + ly * c;
+	}
+}
+} // namespace
+
+void DrawList::RasterizePrimitives(SoftRaster &raster, size_t &line_done, size_t line_end, size_t &triangle_done, size_t triangle_end) const {
+	for (; triangle_done + 2 < triangle_end; triangle_done += 3) {
+		auto v = &triangle_vtx[triangle_done];
+		const float xy[6] = {v[0].x, v[0].y, v[1].x, v[1].y, v[2].x, v[2].y};
+		const SoftColor colors[3] = {ToSoft(triangle_color[triangle_done]), ToSoft(triangle_color[triangle_done + 1]), ToSoft(triangle_color[triangle_done + 2])};
+		raster.Triangle(xy, colors);
+	}
+
+	for (; line_done + 1 < line_end; line_done += 2)
+		raster.Line(line_vtx[line_done].x, line_vtx[line_done].y, line_vtx[line_done + 1].x, line_vtx[line_done + 1].y, ToSoft(line_color[line_done]), ToSoft(line_color[line_done + 1]));
+}
+
+void DrawList::Rasterize(SoftRaster &raster, const SoftImage *(*get_image)(const char *path, void *user), void *user) const {
+	size_t line_done = 0, triangle_done = 0;
+
+	for (auto &cmd : cmds) {
+		auto &v = cmd.v;
+		auto &c = cmd.c;
+
+		switch (cmd.type) {
+			case CmdLine:
+				raster.Line(v[0], v[1], v[2], v[3], ToSoft(c[0]), ToSoft(c[1]));
+				break;
+			case CmdTriangle: {
+				const SoftColor colors[3] = {ToSoft(c[0]), ToSoft(c[1]), ToSoft(c[2])};
+				raster.Triangle(v, colors);
+			} break;
+			case CmdQuad: {
+				const float xy0[6] = {v[0], v[1], v[2], v[3], v[4], v[5]}, xy1[6] = {v[0], v[1], v[4], v[5], v[6], v[7]};
+				const SoftColor colors0[3] = {ToSoft(c[0]), ToSoft(c[1]), ToSoft(c[2])}, colors1[3] = {ToSoft(c[0]), ToSoft(c[2]), ToSoft(c[3])};
+				raster.Triangle(xy0, colors0);
+				raster.Triangle(xy1, colors1);
+			} break;
+			case CmdSprite:
+			case CmdRotatedSprite:
+			case CmdImage: {
+				auto image = get_image(&chars[cmd.str[0]], user);
+				if (!image || !image->w)
+					break;
+
+				float xy[8];
+				if (cmd.type == CmdSprite) // width of size, centered
+					SpriteQuad(v[0], v[1], 0.f, v[2], v[2] * image->h / image->w, 0.5f, 0.5f, xy);
+				else if (cmd.type == CmdRotatedSprite)
+					SpriteQuad(v[0], v[1], v[2], v[3], v[3] * image->h / image->w, v[4], v[5], xy);
+				else // bottom-left corner at x, y, scaled
+					SpriteQuad(v[0], v[1], 0.f, image->w * v[2], image->h * v[2], 0.f, 0.f, xy);
+
+				raster.TexturedQuad(xy, *image, ToSoft(c[0]));
+			} break;
+			case CmdText:
+			case CmdTextCentered:
+				break; // no font rasterizer
+			case CmdViewport:
+				break;
+			case CmdPrimitives:
+				RasterizePrimitives(raster, line_done, cmd.str[0], triangle_done, cmd.str[1]);
+				break;
+		}
+	}
+
+	RasterizePrimitives(raster, line_done, line_vtx.size(), triangle_done, triangle_vtx.size());
+}
+
+void DrawList::ForEachImage(void (*fn)(const char *path, void *user), void *user) const {
+	for (auto &cmd : cmds)
+		if (cmd.type == CmdSprite || cmd.type == CmdRotatedSprite || cmd.type == CmdImage)
+			fn(&chars[cmd.str[0]], user);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "circle_cache.h"
+#include "latency_tracer.h"
+#include "soft_raster.h"
+#include <cstdint>
+#include <engine/mixer.h>
+#include <foundation/color.h>
+#include <foundation/vector3.h>
+#include <memory>
+#include <vector>
+
+// Records the 2D draw calls and sound starts of a frame so that they can be
+// submitted later, possibly from another thread than the one recording them.
+class DrawList {
+public:
+	void Clear();
+
+	void Line2D(float sx, float sy, float ex, float ey, const hg::Color &s_color, const hg::Color &e_color);
+	void Triangle2D(float ax, float ay, float bx, float by, float cx, float cy, const hg::Color &a_color, const hg::Color &b_color, const hg::Color &c_color);
+	void Quad2D(float ax, float ay, float bx, float by, float cx, float cy, float dx, float dy, const hg::Color &a_color, const hg::Color &b_color, const hg::Color &c_color, const hg::Color &d_color);
+	void Sprite2D(float x, float y, float size, const char *image, const hg::Color &color = hg::Color::White);
+	void RotatedSprite2D(float x, float y, float angle, float size, const char *image, const hg::Color &color = hg::Color::White, float pivot_x = 0.5f, float pivot_y = 0.5f);
+	void Image2D(float x, float y, float scale, const char *image, const hg::Color &color = hg::Color::White);
+	void Text2D(float x, float y, const char *text, float size, const hg::Color &color, const char *font_path);
+	/// Text centered on x, y. The text rect is measured at submission.
+	void Text2DCentered(float x, float y, const char *text, float size, const hg::Color &color, const char *font_path);
+
+	/// Circle outlines and discs of nseg segments. They are not recorded as calls but appended to a line and a triangle
+	/// stream, consecutive ones are submitted in one draw each (discs first) in recording order with the other calls.
+	void Circle2D(float x, float y, float radius, int nseg, const hg::Color &color);
+	void Disc2D(float x, float y, float radius, int nseg, const hg::Color &color);
+
+	/// Calls recorded after this one map 2D coordinates from 0, 0 to view_w, view_h onto the x, y, w, h window rect in pixels.
+	/// Each game instance records into its own viewport, the software rasterizer ignores them.
+	void SetViewport(int x, int y, int w, int h, float view_w, float view_h);
+
+	void StartSound(const std::shared_ptr<hg::Sound> &sound, hg::MixerChannelState state = hg::MixerChannelState());
+
+	/// Replay the recorded calls, must run on the render thread.
+	void Submit() const;
+
+	/// Replay the recorded calls in software for the headless runs, get_image returns null for a missing image.
+	/// Text is not rasterized.
+	void Rasterize(SoftRaster &raster, const SoftImage *(*get_image)(const char *path, void *user), void *user) const;
+
+	/// Call fn with the path of each sprite and image drawn, in recording order.
+	void ForEachImage(void (*fn)(const char *path, void *user), void *user) const;
+
+	size_t GetCommandCount() const { return cmds.size(); }
+	size_t GetPrimitiveVertexCount() const { return line_vtx.size() + triangle_vtx.size(); }
+	/// Runs of consecutive circles and discs, each submitted as one triangle and one line draw at most.
+	size_t GetPrimitiveRunCount() const;
+
+	/// Shots fired while recording, completed once the list is shown.
+	void AddLatencyTrace(const LatencyTrace &trace) { traces.push_back(trace); }
+	const std::vector<LatencyTrace> &GetLatencyTraces() const { return traces; }
+
+private:
+	enum CmdType : uint8_t { CmdLine, CmdTriangle, CmdQuad, CmdSprite, CmdRotatedSprite, CmdImage, CmdText, CmdTextCentered, CmdViewport, CmdPrimitives };
+
+	struct Cmd {
+		CmdType type;
+		float v[8];
+		hg::Color c[4];
+		uint32_t str[2]; // offsets in chars, stream ends for CmdPrimitives
+	};
+
+	Cmd &Push(CmdType type);
+	void SubmitPrimitives(size_t &line_done, size_t line_end, size_t &triangle_done, size_t triangle_end) const;
+	void RasterizePrimitives(SoftRaster &raster, size_t &line_done, size_t line_end, size_t &triangle_done, size_t triangle_end) const;
+	uint32_t PushString(const char *str);
+
+	std::vector<Cmd> cmds;
+	std::vector<char> chars; // strings are copied, recorded calls may use frame local text
+
+	struct SoundCmd {
+		hg::Sound *sound;
+		hg::MixerChannelState state;
+	};
+
+	std::vector<SoundCmd> sounds;
+
+	CircleCache circles;
+
+	std::vector<hg::Vector3> line_vtx, triangle_vtx;
+	std::vector<hg::Color> line_color, triangle_color;
+	size_t line_mark = 0, triangle_mark = 0; // stream ends at the last CmdPrimitives
+
+	std::vector<LatencyTrace> traces;
+};
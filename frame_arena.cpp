@@ -0,0 +1,55 @@
+#include "frame_arena.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+FrameArena g_frame_arena(256 * 1024);
+
+FrameArena::FrameArena(size_t capacity) : buffer(static_cast<uint8_t *>(malloc(capacity))), capacity(capacity) {}
+
+FrameArena::~FrameArena() {
+	Reset();
+	free(buffer);
+}
+
+void *FrameArena::Alloc(size_t size, size_t align) {
+	auto offset = (used + align - 1) & ~(align - 1);
+
+	if (offset + size > capacity) { // out of arena, fall back to the heap until the next reset
+		++overflow_count;
+		auto p = malloc(size ? size : 1);
+		if (!p)
+			throw std::bad_alloc();
+		overflow.push_back(p);
+		return p;
+	}
+
+	used = offset + size;
+	if (used > peak)
+		peak = used;
+	return buffer + offset;
+}
+
+void FrameArena::Reset() {
+	for (auto p : overflow)
+		free(p);
+	overflow.clear();
+	used = 0;
+}
+
+//
+const char *FrameFormat(const char *fmt, ...) {
+	va_list args, args_copy;
+	va_start(args, fmt);
+	va_copy(args_copy, args);
+
+	auto len = vsnprintf(nullptr, 0, fmt, args);
+	auto str = static_cast<char *>(g_frame_arena.Alloc(len + 1, 1));
+	vsnprintf(str, len + 1, fmt, args_copy);
+
+	va_end(args_copy);
+	va_end(args);
+	return str;
+}
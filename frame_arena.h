@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Linear allocator for data that does not outlive the current frame.
+// Everything allocated is released at once by Reset() at the end of the frame.
+class FrameArena {
+public:
+	explicit FrameArena(size_t capacity);
+	~FrameArena();
+
+	FrameArena(const FrameArena &) = delete;
+	FrameArena &operator=(const FrameArena &) = delete;
+
+	void *Alloc(size_t size, size_t align = alignof(std::max_align_t));
+
+	/// Release all allocations.
+	void Reset();
+
+	/// Mark/Rewind release the allocations made after the mark was taken.
+	size_t GetMark() const { return used; }
+	void Rewind(size_t mark) { used = mark; }
+
+	size_t GetCapacity() const { return capacity; }
+	size_t GetPeak() const { return peak; }
+	/// Allocations that did not fit and went to the heap since the last call.
+	size_t TakeOverflowCount() {
+		auto n = overflow_count;
+		overflow_count = 0;
+		return n;
+	}
+
+private:
+	uint8_t *buffer;
+	size_t capacity, used{0}, peak{0};
+
+	std::vector<void *> overflow;
+	size_t overflow_count{0};
+};
+
+extern FrameArena g_frame_arena;
+
+/// Release the frame arena allocations made during the scope lifetime.
+class FrameArenaScope {
+public:
+	FrameArenaScope() : mark(g_frame_arena.GetMark()) {}
+	~FrameArenaScope() { g_frame_arena.Rewind(mark); }
+
+private:
+	size_t mark;
+};
+
+/// STL allocator drawing from the frame arena, deallocation is a no-op.
+template <typename T> struct FrameAllocator {
+	typedef T value_type;
+
+	FrameAllocator() = default;
+	template <typename U> FrameAllocator(const FrameAllocator<U> &) {}
+
+	T *allocate(size_t n) { return static_cast<T *>(g_frame_arena.Alloc(n * sizeof(T), alignof(T))); }
+	void deallocate(T *, size_t) {}
+
+	template <typename U> bool operator==(const FrameAllocator<U> &) const { return true; }
+	template <typename U> bool operator!=(const FrameAllocator<U> &) const { return false; }
+};
+
+template <typename T> using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+/// printf-style formatting to a string valid until the end of the frame.
+const char *FrameFormat(const char *fmt, ...);
@@ -0,0 +1,147 @@
+#include "frame_capture.h"
+#include "png_encoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+FrameCapture::FrameCapture(const char *dir_, int w_, int h_, bool bottom_up_, int buffer_count, int worker_count) : dir(dir_), w(w_), h(h_), bottom_up(bottom_up_) {
+	buffers.resize(std::max(buffer_count, 1));
+	for (auto &buffer : buffers) {
+		buffer.resize(size_t(w) * h * 4);
+		free_buffers.push_back(buffer.data());
+	}
+
+	if (worker_count <= 0)
+		worker_count = std::max(int(std::thread::hardware_concurrency()) - 1, 1); // the game thread keeps its core
+
+	for (int i = 0; i < worker_count; ++i)
+		workers.emplace_back([this]() { Run(); });
+}
+
+FrameCapture::~FrameCapture() {
+	Flush();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	cv.notify_all();
+
+	for (auto &worker : workers)
+		worker.join();
+}
+
+uint8_t *FrameCapture::Acquire(bool wait) {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (wait)
+		idle_cv.wait(lock, [this]() { return !free_buffers.empty(); });
+
+	if (free_buffers.empty()) {
+		++dropped_count;
+		return nullptr;
+	}
+
+	auto buffer = free_buffers.back();
+	free_buffers.pop_back();
+	return buffer;
+}
+
+void FrameCapture::Submit(uint8_t *buffer, int frame_index) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back({buffer, frame_index});
+	}
+	cv.notify_one();
+}
+
+void FrameCapture::Flush() {
+	std::unique_lock<std::mutex> lock(mutex);
+	idle_cv.wait(lock, [this]() { return jobs.empty() && !busy_count; });
+}
+
+std::string FrameCapture::GetFramePath(const char *dir, int frame_index) {
+	char name[32];
+	snprintf(name, sizeof(name), "/frame_%06d.png", frame_index);
+	return std::string(dir) + name;
+}
+
+void FrameCapture::Run() {
+	std::vector<uint8_t> png;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		cv.wait(lock, [this]() { return quit || !jobs.empty(); });
+		if (jobs.empty())
+			break; // quit once the queue is drained
+
+		auto job = jobs.front();
+		jobs.pop_front();
+		++busy_count;
+		lock.unlock();
+
+		auto t = std::chrono::steady_clock::now();
+		EncodePNG(job.buffer, w, h, w * 4, bottom_up, png);
+		auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+
+		bool ok = false;
+		if (auto file = fopen(GetFramePath(dir.c_str(), job.frame_index).c_str(), "wb")) {
+			ok = fwrite(png.data(), 1, png.size(), file) == png.size();
+			ok = fclose(file) == 0 && ok;
+		}
+
+		lock.lock();
+		free_buffers.push_back(job.buffer);
+		--busy_count;
+		encode_ms += ms;
+		if (ok)
+			++written_count;
+		else
+			++failed_count;
+
+		idle_cv.notify_all(); // a buffer is free, maybe all of them
+	}
+}
+
+uint32_t FrameCapture::GetWrittenCount() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return written_count;
+}
+
+uint32_t FrameCapture::GetFailedCount() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return failed_count;
+}
+
+float FrameCapture::GetMeanEncodeMs() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto count = written_count + failed_count;
+	return count ? float(encode_ms / count) : 0.f;
+}
+
+//
+FrameDiff CompareFrames(const uint8_t *a, int stride_a, const uint8_t *b, int stride_b, int w, int h, int threshold) {
+	FrameDiff diff{0, 0, 0};
+	uint64_t sum = 0;
+
+	for (int y = 0; y < h; ++y) {
+		auto row_a = a + size_t(y) * stride_a, row_b = b + size_t(y) * stride_b;
+
+		for (int x = 0; x < w * 4; x += 4) {
+			int pixel_max = 0;
+			for (int c = 0; c < 4; ++c) {
+				auto e = std::abs(int(row_a[x + c]) - int(row_b[x + c]));
+				sum += e;
+				pixel_max = std::max(pixel_max, e);
+			}
+
+			diff.max_error = std::max(diff.max_error, pixel_max);
+			if (pixel_max > threshold)
+				++diff.differing_pixels;
+		}
+	}
+
+	diff.mean_error = w && h ? double(sum) / (double(w) * h * 4) : 0.0;
+	return diff;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Frame capture to numbered PNG files. The game thread copies each frame into
+// one of a pool of reusable buffers and queues it, worker threads encode and
+// write it. When every buffer is still being encoded the frame is dropped and
+// counted rather than making the game wait.
+//
+// No engine dependency: pixels come from a framebuffer readback or from the
+// software rasterizer of the headless runs.
+class FrameCapture {
+public:
+	/// Frames are w x h RGBA8, bottom_up when their first row is the bottom one. 0 workers picks one per core but one.
+	FrameCapture(const char *dir, int w, int h, bool bottom_up, int buffer_count = 8, int worker_count = 0);
+	~FrameCapture();
+
+	/// A free buffer of w * h * 4 bytes for the next frame, null when the frame has to be dropped.
+	/// Offline captures can wait for a buffer instead.
+	uint8_t *Acquire(bool wait = false);
+	/// Queue an acquired buffer, written as <dir>/frame_<index>.png
+	void Submit(uint8_t *buffer, int frame_index);
+
+	/// Wait for the queued frames to be written.
+	void Flush();
+
+	int GetWidth() const { return w; }
+	int GetHeight() const { return h; }
+
+	uint32_t GetWrittenCount() const;
+	uint32_t GetDroppedCount() const { return dropped_count; }
+	uint32_t GetFailedCount() const;
+	float GetMeanEncodeMs() const;
+
+	/// Path of a frame file in dir, as written by the capture.
+	static std::string GetFramePath(const char *dir, int frame_index);
+
+private:
+	struct Job {
+		uint8_t *buffer;
+		int frame_index;
+	};
+
+	void Run();
+
+	std::string dir;
+	int w, h;
+	bool bottom_up;
+
+	std::vector<std::vector<uint8_t>> buffers;
+	std::vector<uint8_t *> free_buffers;
+
+	mutable std::mutex mutex;
+	std::condition_variable cv, idle_cv;
+	std::deque<Job> jobs;
+	int busy_count{0};
+	bool quit{false};
+
+	uint32_t written_count{0}, failed_count{0}, dropped_count{0};
+	double encode_ms{0};
+
+	std::vector<std::thread> workers;
+};
+
+struct FrameDiff {
+	double mean_error; // per channel, 0 to 255
+	int max_error;
+	int differing_pixels; // with a channel off by more than the threshold
+};
+
+/// Compare two w x h RGBA8 frames.
+FrameDiff CompareFrames(const uint8_t *a, int stride_a, const uint8_t *b, int stride_b, int w, int h, int threshold);
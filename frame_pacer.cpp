@@ -0,0 +1,90 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <timeapi.h>
+#endif
+
+namespace {
+int64_t Now() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+} // namespace
+
+FramePacer::FramePacer(int64_t spin_ns_) : spin_ns(spin_ns_) {
+#if defined(_WIN32)
+	timeBeginPeriod(1); // the default 15.6ms scheduler tick would make every sleep overshoot a frame
+#endif
+}
+
+FramePacer::~FramePacer() {
+#if defined(_WIN32)
+	timeEndPeriod(1);
+#endif
+}
+
+void FramePacer::SetInterval(int64_t ns) {
+	ns = std::max<int64_t>(ns, 0);
+	if (ns == interval)
+		return;
+
+	interval = ns;
+	deadline = 0; // restart from the next frame
+	interval_count = late_count = 0; // do not mix targets in a report
+}
+
+void FramePacer::Wait() {
+	auto now = Now();
+
+	if (interval > 0) {
+		if (deadline == 0 || now - deadline > interval) {
+			if (deadline)
+				++late_count;
+			deadline = now; // first frame or late by more than a frame, restart from here
+		} else {
+			if (deadline - now > spin_ns)
+				std::this_thread::sleep_for(std::chrono::nanoseconds(deadline - now - spin_ns));
+			while ((now = Now()) < deadline)
+				std::this_thread::yield();
+
+			if (now - deadline >= interval / 4)
+				++late_count;
+		}
+		deadline += interval;
+	}
+
+	if (last_release) {
+		intervals[interval_count++] = now - last_release;
+
+		if (interval_count == window_size) {
+			std::array<float, window_size> deviation;
+
+			double sum = 0;
+			for (auto i : intervals)
+				sum += double(i);
+			auto mean = sum / window_size;
+			auto reference = interval > 0 ? double(interval) : mean;
+
+			for (int i = 0; i < window_size; ++i)
+				deviation[i] = float(std::fabs(double(intervals[i]) - reference) * 1e-6);
+			std::sort(deviation.begin(), deviation.end());
+
+			report = {interval, window_size, float(mean * 1e-6), deviation[window_size / 2], deviation[(window_size * 99) / 100], deviation[window_size - 1], late_count};
+			report_ready = true;
+			interval_count = late_count = 0;
+		}
+	}
+	last_release = now;
+}
+
+bool FramePacer::TakeReport(Jitter &jitter) {
+	if (!report_ready)
+		return false;
+
+	jitter = report;
+	report_ready = false;
+	return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Frame pacer: holds each frame until its deadline, sleeping most of the wait
+// then spinning the last stretch, which OS sleeps overshoot. Deadlines advance
+// by the interval from the previous one so that the rate does not drift, and
+// restart from now after a late frame instead of bursting to catch up.
+//
+// The pacer also measures the interval between frames it releases and reports
+// how far they stray from the target, to check that pacing does not add stutter.
+// No engine dependency: times are steady clock nanoseconds.
+class FramePacer {
+public:
+	static constexpr int window_size = 600; // frames per jitter report
+
+	explicit FramePacer(int64_t spin_ns = 2000000);
+	~FramePacer();
+
+	/// 0 leaves frames unpaced (vsync only).
+	void SetInterval(int64_t ns);
+	int64_t GetInterval() const { return interval; }
+
+	/// Wait for the deadline of the next frame, call once per frame.
+	void Wait();
+
+	struct Jitter {
+		int64_t interval; // target, 0 when unpaced
+		int frame_count;
+		float mean_ms; // of the intervals
+		float p50_ms, p99_ms, max_ms; // absolute deviation from the target, or the mean when unpaced
+		int late_count; // frames released a quarter interval or more past their deadline
+	};
+
+	/// True every window_size frames, jitter then holds the window.
+	bool TakeReport(Jitter &jitter);
+
+private:
+	int64_t spin_ns;
+	int64_t interval{0}, deadline{0};
+	int64_t last_release{0};
+
+	std::array<int64_t, window_size> intervals; // released frame intervals
+	int interval_count{0}, late_count{0};
+	bool report_ready{false};
+	Jitter report{};
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+// Gameplay constants shared by the game and the batched training environment.
+// Speeds and damping are per simulation step at 60Hz.
+constexpr int width = 720, height = 1280;
+constexpr int playfield_padding = 50;
+
+constexpr float player_damping = 0.999f;
+constexpr float player_radius = 50.f;
+constexpr float player_to_player_collision_damping = 0.5f;
+constexpr float player_to_wall_collision_damping = 0.5f;
+
+constexpr float player_decoy_coef = -0.075f;
+constexpr float shoot_to_player_transfer_coef = 0.125f;
+
+constexpr float shoot_radius = 20.f;
+constexpr float shoot_speed = 40.f;
+
+constexpr float ai_aiming_speed = 0.1f;
+
+constexpr float first_shoot_delay = 3.f; // seconds
+constexpr float shoot_spawn_min_delay = 1.f, shoot_spawn_max_delay = 3.5f;
+
+// spawn delays are counted in whole steps so that the game and the environment spawn on the same step
+constexpr int StepsFromSec(float sec) { return int(sec * 60.f + 0.5f); }
+
+constexpr int alien_hit_damage = 5; // last transfer hits the alien
+constexpr int alien_miss_damage = 10; // last transfer misses the alien, damage to the humans
+constexpr int chain_break_damage = 5; // a shot leaves the playfield mid sequence
@@ -0,0 +1,112 @@
+#include "input_sampler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+int64_t InputClock() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+namespace {
+constexpr float stick_epsilon = 1.f / 256.f; // below the noise of a resting stick
+} // namespace
+
+InputSampler::InputSampler(InputPollFn poll, void *user_, int device_count_) : poll_fn(poll), user(user_), device_count(std::min(std::max(device_count_, 0), input_max_devices)) {}
+
+bool InputSampler::Start(int rate_hz) {
+	if (IsRunning() || rate_hz <= 0)
+		return false;
+
+	quit = false;
+	auto period = std::chrono::nanoseconds(1000000000 / rate_hz);
+
+	thread = std::thread([this, period]() {
+		auto next = std::chrono::steady_clock::now();
+		while (!quit) {
+			Sample();
+
+			next += period;
+			auto now = std::chrono::steady_clock::now();
+			if (next < now)
+				next = now; // the OS held the thread, do not burst to catch up
+			std::this_thread::sleep_until(next);
+		}
+	});
+	return true;
+}
+
+void InputSampler::Stop() {
+	if (!IsRunning())
+		return;
+
+	quit = true;
+	thread.join();
+}
+
+//
+bool InputSampler::Push(const Event &event) {
+	auto t = tail.load(std::memory_order_relaxed);
+	if (t - head.load(std::memory_order_acquire) >= queue_size)
+		return false;
+
+	queue[t & (queue_size - 1)] = event;
+	tail.store(t + 1, std::memory_order_release);
+	return true;
+}
+
+void InputSampler::Sample() {
+	std::array<InputDeviceState, input_max_devices> states{};
+	poll_fn(states.data(), device_count, user);
+
+	auto time = InputClock();
+
+	for (int i = 0; i < device_count; ++i) {
+		auto &state = states[i];
+		auto &last = sampled[i];
+
+		if (state.buttons == last.buttons && std::fabs(state.x - last.x) < stick_epsilon && std::fabs(state.y - last.y) < stick_epsilon)
+			continue;
+
+		if (Push({time, state.x, state.y, uint8_t(i), state.buttons}))
+			last = state;
+		else
+			++delayed_count; // last is kept, the change is seen again next sample
+	}
+}
+
+//
+void InputSampler::TakeSnapshot(InputSnapshot &snapshot) {
+	for (auto &device : snapshot.devices)
+		device.pressed = 0;
+	snapshot.event_count = 0;
+
+	auto h = head.load(std::memory_order_relaxed);
+	auto t = tail.load(std::memory_order_acquire);
+
+	for (; h != t; ++h) {
+		auto &event = queue[h & (queue_size - 1)];
+		auto &state = current[event.device];
+		auto &device = snapshot.devices[event.device];
+
+		uint8_t went_down = event.buttons & ~state.buttons & ~device.pressed; // the first press of a button wins
+		for (int b = 0; b < input_button_count; ++b)
+			if (went_down & (1 << b))
+				device.press_time[b] = event.time;
+
+		device.pressed |= went_down;
+		state.buttons = event.buttons;
+		state.x = event.x;
+		state.y = event.y;
+		++snapshot.event_count;
+	}
+
+	head.store(h, std::memory_order_release);
+
+	for (int i = 0; i < device_count; ++i) {
+		auto &device = snapshot.devices[i];
+		device.down = current[i].buttons;
+		device.x = current[i].x;
+		device.y = current[i].y;
+	}
+
+	snapshot.time = InputClock();
+}
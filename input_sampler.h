@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+// Input sampling thread: devices are polled at a high rate and every button
+// edge or stick move is pushed with its timestamp into a lock-free queue. The
+// game drains the queue into an immutable snapshot once per frame, so a press
+// and release between two frames still shows as a press, and reading input
+// costs one pass over the devices whatever the number of queries.
+//
+// No engine dependency: devices are read through the poll callback, which must
+// only be called from one thread at a time (the sampler, or the game thread
+// when the sampler is not running).
+constexpr int input_max_devices = 8;
+constexpr int input_button_count = 8; // per device, as bits
+
+struct InputDeviceState {
+	uint8_t buttons; // held
+	float x, y; // stick
+};
+
+/// Fill the raw state of count devices.
+typedef void (*InputPollFn)(InputDeviceState *states, int count, void *user);
+
+struct InputDeviceSnapshot {
+	uint8_t down; // held when the snapshot was taken
+	uint8_t pressed; // went down since the previous snapshot, even if released since
+	float x, y;
+	int64_t press_time[input_button_count]; // first press of each pressed button, on the InputClock
+};
+
+struct InputSnapshot {
+	int64_t time{0}; // on the InputClock
+	std::array<InputDeviceSnapshot, input_max_devices> devices{};
+	uint32_t event_count{0}; // drained into this snapshot
+};
+
+/// Monotonic nanoseconds, the clock of all input timestamps.
+int64_t InputClock();
+
+class InputSampler {
+public:
+	InputSampler(InputPollFn poll, void *user, int device_count);
+	~InputSampler() { Stop(); }
+
+	/// Sample from a thread at rate_hz.
+	bool Start(int rate_hz);
+	void Stop();
+	bool IsRunning() const { return thread.joinable(); }
+
+	/// Poll the devices once and queue the changes, called by the sampling thread.
+	void Sample();
+
+	/// Drain the queued events, call from a single thread.
+	void TakeSnapshot(InputSnapshot &snapshot);
+
+	/// Events that found the queue full, their change is queued again on a later sample.
+	uint64_t GetDelayedCount() const { return delayed_count; }
+
+private:
+	struct Event {
+		int64_t time;
+		float x, y;
+		uint8_t device, buttons;
+	};
+
+	bool Push(const Event &event);
+
+	InputPollFn poll_fn;
+	void *user;
+	int device_count;
+
+	// single producer, single consumer
+	static constexpr uint32_t queue_size = 4096; // power of two, seconds of continuous stick motion
+	std::array<Event, queue_size> queue;
+	std::atomic<uint32_t> head{0}, tail{0};
+
+	std::array<InputDeviceState, input_max_devices> sampled{}; // producer side, last queued state
+	std::array<InputDeviceState, input_max_devices> current{}; // consumer side
+	std::atomic<uint64_t> delayed_count{0};
+
+	std::thread thread;
+	std::atomic<bool> quit{false};
+};
@@ -0,0 +1,45 @@
+#include "latency_tracer.h"
+
+#include <algorithm>
+
+void LatencyHistogram::Add(float ms) {
+	ms = std::max(ms, 0.f);
+
+	++buckets[std::min(int(ms / bucket_ms), bucket_count - 1)];
+	++count;
+	sum_ms += ms;
+	max_ms = std::max(max_ms, ms);
+}
+
+float LatencyHistogram::GetPercentileMs(float p) const {
+	if (!count)
+		return 0.f;
+
+	auto rank = std::max(uint32_t(double(count) * p + 0.5), 1u);
+
+	uint32_t seen = 0;
+	for (int i = 0; i < bucket_count - 1; ++i)
+		if ((seen += buckets[i]) >= rank)
+			return std::min((i + 1) * bucket_ms, max_ms);
+	return max_ms;
+}
+
+//
+void LatencyTracer::Complete(const LatencyTrace &trace, int64_t sound, int64_t flip) {
+	if (trace.source >= latency_max_sources)
+		return;
+
+	auto &h = histograms[trace.source];
+	auto to_ms = [&trace](int64_t t) { return float(double(t - trace.press) * 1e-6); };
+
+	h[LatencyToInput].Add(to_ms(trace.input));
+	h[LatencyToFire].Add(to_ms(trace.fire));
+	if (trace.sound)
+		h[LatencyToSound].Add(to_ms(sound));
+	h[LatencyToFlip].Add(to_ms(flip));
+}
+
+void LatencyTracer::Reset(int source) {
+	for (auto &h : histograms[source])
+		h.Reset();
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Input to output latency of fired shots. A press is stamped by the input
+// sampler, then when UpdatePlayerInputs consumes it, when PlayerFireShot fires,
+// when the frame recording the shot starts its sound in the mixer and when
+// the Flip showing it returns. Each span from the press goes into a fixed
+// histogram per input source, so tracing is a few stores per shot and can
+// stay on in every build.
+//
+// No engine dependency: times are on the InputClock.
+enum LatencySpan { LatencyToInput, LatencyToFire, LatencyToSound, LatencyToFlip, LatencySpanCount };
+
+constexpr int latency_max_sources = 4;
+
+struct LatencyTrace {
+	int64_t press, input, fire;
+	uint8_t source;
+	bool sound; // the shot sound was queued
+};
+
+class LatencyHistogram {
+public:
+	static constexpr float bucket_ms = 0.25f;
+	static constexpr int bucket_count = 512; // up to 128ms, slower ones go in the last bucket
+
+	void Add(float ms);
+	void Reset() { *this = LatencyHistogram(); }
+
+	uint32_t GetCount() const { return count; }
+	float GetMeanMs() const { return count ? float(sum_ms / count) : 0.f; }
+	float GetMaxMs() const { return max_ms; }
+	/// Upper bound of the bucket holding the p-th fraction of the samples.
+	float GetPercentileMs(float p) const;
+
+private:
+	std::array<uint32_t, bucket_count> buckets{};
+	uint32_t count{0};
+	double sum_ms{0};
+	float max_ms{0};
+};
+
+class LatencyTracer {
+public:
+	/// The frame recording the trace started its sounds at sound and was shown at flip.
+	void Complete(const LatencyTrace &trace, int64_t sound, int64_t flip);
+
+	const LatencyHistogram &GetHistogram(int source, LatencySpan span) const { return histograms[source][span]; }
+	uint32_t GetCount(int source) const { return histograms[source][LatencyToFlip].GetCount(); }
+
+	void Reset(int source);
+
+private:
+	std::array<std::array<LatencyHistogram, LatencySpanCount>, latency_max_sources> histograms;
+};
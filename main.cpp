@@ -1,90 +1,83 @@
+#include "alloc_tracker.h"
+#include "batch_env.h"
+#include "det_math.h"
+#include "draw_list.h"
+#include "frame_arena.h"
+#include "frame_capture.h"
+#include "frame_pacer.h"
+#include "gameplay.h"
+#include "input_sampler.h"
+#include "latency_tracer.h"
+#include "metrics_server.h"
+#include "resolution_controller.h"
+#include "soft_mixer.h"
+#include "stress_ramp.h"
+#include "telemetry.h"
+#include "texture_budget.h"
+#include "timer_wheel.h"
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <engine/audio_io.h>
 #include <engine/engine.h>
 #include <engine/init.h>
 #include <engine/mixer.h>
+#include <engine/picture_io.h>
 #include <engine/plugin_system.h>
 #include <engine/plus.h>
+#include <engine/render_system.h>
+#include <engine/renderer.h>
 #include <engine/zip_file_driver.h>
 #include <foundation/color_api.h>
+#include <foundation/data.h>
 #include <foundation/filesystem.h>
 #include <foundation/log.h>
 #include <foundation/math.h>
 #include <foundation/path_tools.h>
+#include <foundation/picture.h>
 #include <foundation/random.h>
 #include <foundation/time.h>
 #include <foundation/unit.h>
 #include <foundation/vector2.h>
 #include <functional>
+#include <mutex>
 #include <platform/input_device.h>
 #include <platform/input_system.h>
+#include <thread>
+#include <unordered_map>
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+}
 
 using namespace hg;
 
 //
-constexpr int width = 720, height = 1280;
-constexpr int playfield_padding = 50;
-
-constexpr float player_damping = 0.999f;
-constexpr float player_radius = 50.f;
-constexpr float player_to_player_collision_damping = 0.5f;
-constexpr float player_to_wall_collision_damping = 0.5f;
-
-constexpr float player_decoy_coef = -0.075f;
-constexpr float shoot_to_player_transfer_coef = 0.125f;
-
-constexpr float shoot_radius = 20.f;
-constexpr float shoot_speed = 40.f;
-constexpr time_ns shoot_hold_duration = time_from_sec(4);
-
 constexpr time_ns ai_min_delay = time_from_sec_f(0.5f);
 constexpr time_ns ai_max_delay = time_from_sec_f(2.5f);
 constexpr float ai_precision_delta = Deg(5.f);
-constexpr float ai_aiming_speed = 0.1f;
 
-//
-int human_health, alien_health;
+// gameplay speeds are expressed per step at the reference rate, ticks at other rates scale them
+constexpr time_ns sim_reference_step = time_from_sec(1) / 60;
 
-//   ddd
-std::shared_ptr<hg::Sound> piout, beep, explosion, bidon, tako;
+time_ns sim_step = sim_reference_step; // fixed simulation step, see -sim-rate
 
-bool LoadSoundFXs() {
-	explosion = g_plus.get().GetMixer()->LoadSound("@data:explosion.ogg");
-	piout = g_plus.get().GetMixer()->LoadSound("@data:piout.ogg");
-	beep = g_plus.get().GetMixer()->LoadSound("@data:beep.ogg");
-	bidon = g_plus.get().GetMixer()->LoadSound("@data:bidon.ogg");
-	tako = g_plus.get().GetMixer()->LoadSound("@data:tako.ogg");
-	return bool(piout);
-}
+time_ns fixed_frame_duration{0}; // headless runs record frames at a fixed rate
 
-//
-void DrawCircle(float x, float y, float radius, int nseg, const Color &col) {
-	float step = Deg(360.f) / nseg, angle = 0.f;
-	float sx = Sin(angle) * radius + x, sy = Cos(angle) * radius + y, ex, ey;
-	for (int i = 0; i < nseg; ++i) {
-		angle += step;
-		ex = Sin(angle) * radius + x;
-		ey = Cos(angle) * radius + y;
-		g_plus.get().Line2D(sx, sy, ex, ey, col, col);
-		sx = ex;
-		sy = ey;
-	}
-}
+// duration of the frame being recorded as seen by the game, frame time measurements keep using GetLastFrameDuration
+time_ns GetFrameDuration() { return fixed_frame_duration ? fixed_frame_duration : GetLastFrameDuration(); }
 
-void DrawDisc(float x, float y, float radius, int nseg, const Color &col) {
-	float step = Deg(360.f) / nseg, angle = 0.f;
-	float sx = Sin(angle) * radius + x, sy = Cos(angle) * radius + y, ex, ey;
-	for (int i = 0; i < nseg; ++i) {
-		angle += step;
-		ex = Sin(angle) * radius + x;
-		ey = Cos(angle) * radius + y;
-		g_plus.get().Triangle2D(ex, ey, x, y, sx, sy, col, col, col);
-		sx = ex;
-		sy = ey;
-	}
-}
+float tick_scale{1}; // duration of the simulation step being run relative to sim_reference_step
+uint64_t tick_count{0};
+float tick_damping{player_damping}, tick_aiming{ai_aiming_speed}; // per step rates scaled to tick_scale
 
 //
 struct Shoot {
@@ -94,40 +87,142 @@ struct Shoot {
 	Vector2 pos;
 	Vector2 spd;
 
-	time_ns hold_until;
+	bool held; // by the drone at player_seq[player_seq_idx]
 };
 
-std::vector<Shoot> shoots;
-
-void SpawnShoot();
-std::vector<int> GetPlayerShoots(int idx);
-
-void SpawnFX(float x, float y, const char *img, float size, float rotation = 0, time_ns duration = time_from_sec(2), time_ns delay = 0, Color color = Color(1, 1, 1, 1), float size_spd = 0.f);
-
-void ShakeBG(float strength);
-
-//
-bool IsFading();
-void FadeTo(const Color &col, time_ns duration = time_from_sec_f(0.25f));
-void SetFade(const Color &col);
-
-//
 struct Player {
 	Vector2 pos{0, 0};
 	Vector2 spd{0, 0};
 	float angle{0};
 
-	std::string msg;
-	time_ns msg_delay{0};
+	const char *msg{""};
+	TimerHandle msg_timer;
 
 	bool ai{true};
 	float ai_angle{0};
-	time_ns ai_shot_delay{0};
+	TimerHandle ai_shot_timer; // only runs while the drone holds a shot
+	bool ai_shot_ready{false};
 
 	int gamepad{-1};
+
+	bool wall_contact{false}; // the bump sound plays when a contact starts
+};
+
+struct FX {
+	const char *img;
+	Vector2 pos;
+	float size;
+	float rotation;
+	time_ns start, end; // on the frame timers clock
+	Color color;
+	float size_spd;
+};
+
+typedef bool (*GameState)();
+
+// A match and its presentation state. Several instances can run in one process (see -instances), each drawn to its
+// own viewport and reading its own input devices. Assets are not part of an instance: textures and fonts live in the
+// render system cache and sounds in the mixer, loaded once and shared by all instances.
+struct GameInstance {
+	GameState game_state{nullptr}, next_game_state{nullptr};
+
+	// presentation timers run on the frame clock, simulation timers on ticks so that they follow -sim-rate and replays
+	TimerWheel frame_timers{time_from_sec(1) / 120}, sim_timers{sim_reference_step};
+	time_ns sim_accumulator{0};
+
+	int human_health{0}, alien_health{0};
+
+	std::array<Player, 4> players;
+	uint16_t player_contacts{0}; // pairs of drones in contact, bit a * 4 + b with a < b
+	std::vector<Shoot> shoots;
+	std::vector<FX> fxs;
+
+	const char *earth_msg{""}, *alien_msg{""};
+	TimerHandle earth_msg_timer, alien_msg_timer;
+
+	float bg_shake_strength{0.f};
+
+	Color fade_color{0, 0, 0, 0}, fade_to{0, 0, 0, 0};
+	TimerHandle fade_timer;
+	time_ns fade_t{0};
+
+	const char *game_over_img{""};
+
+	bool attract_mode{false};
+	TimerHandle attract_mode_timer;
+
+	float stress_shots_due{0}, stress_splats_due{0}, stress_msgs_due{0};
+
+	time_ns how_to_play_start{0}; // on the frame timers clock
+	bool how_to_play_can_start_game{false};
+	GameState how_to_play_branch_to{nullptr};
+
+	TimerHandle join_timer;
+	time_ns join_delay{0}; // left when last updated, frozen once the join is done
+
+	int intro_seq{0};
+	TimerHandle intro_seq_timer;
+	time_ns intro_start{0}; // on the frame timers clock
+
+	bool title_loop_attract{true};
+
+	uint32_t device_mask{0xff}; // bit i is set when gamepads[i] drives this instance
+	int viewport[4]{0, 0, width, height}; // x, y, w, h in window pixels
 };
 
-std::array<Player, 4> players;
+std::vector<GameInstance> instances(1); // sized once before the first frame, timers keep pointers into them
+GameInstance *game = &instances[0]; // the instance being recorded or ticked
+
+constexpr int max_instances = 8; // one per device slot
+int window_width{width}, window_height{height};
+
+//   ddd
+enum SFX { SfxPiout, SfxBeep, SfxExplosion, SfxBidon, SfxTako, SfxCount };
+
+static const char *sfx_paths[SfxCount] = {"@data:piout.ogg", "@data:beep.ogg", "@data:explosion.ogg", "@data:bidon.ogg", "@data:tako.ogg"};
+
+std::array<std::shared_ptr<hg::Sound>, SfxCount> sfx_sounds;
+std::array<PcmSound, SfxCount> sfx_pcm; // decoded for the software mixer
+SoftMixer *soft_mixer{nullptr}; // set by the headless audio runs, see -audio-out
+
+bool headless{false}; // no render or audio device, simulation only
+
+// the frame being recorded, submitted to the renderer and mixer by the main thread
+DrawList draw_lists[2];
+DrawList *draw = &draw_lists[0];
+
+// audio and input are initialized between the first frames, the game reads these from the recording thread
+std::atomic<bool> audio_ready{false}, input_ready{false}, startup_failed{false};
+std::atomic<bool> quit_requested{false}; // a game state ended the run, eg. the stress mode
+
+uint64_t mixer_start_count{0};
+
+void PlaySFX(SFX sfx, float gain = 1.f) {
+	if (soft_mixer) {
+		soft_mixer->Start(sfx_pcm[sfx], gain);
+		++mixer_start_count;
+	} else if (!headless && audio_ready) {
+		draw->StartSound(sfx_sounds[sfx], MixerChannelState(gain));
+		++mixer_start_count;
+	}
+}
+
+//
+void DrawCircle(float x, float y, float radius, int nseg, const Color &col) { draw->Circle2D(x, y, radius, nseg, col); }
+void DrawDisc(float x, float y, float radius, int nseg, const Color &col) { draw->Disc2D(x, y, radius, nseg, col); }
+
+//
+void SpawnShoot();
+FrameVector<int> GetPlayerShoots(int idx);
+
+void SpawnFX(float x, float y, const char *img, float size, float rotation = 0, time_ns duration = time_from_sec(2), time_ns delay = 0, Color color = Color(1, 1, 1, 1), float size_spd = 0.f);
+
+void ShakeBG(float strength);
+
+//
+bool IsFading();
+void FadeTo(const Color &col, time_ns duration = time_from_sec_f(0.25f));
+void SetFade(const Color &col);
 
 //
 enum GameInputType {
@@ -136,8 +231,8 @@ enum GameInputType {
 };
 
 int GetNextPlayer() {
-	for (size_t i = 0; players.size(); i++)
-		if (players[i].ai)
+	for (size_t i = 0; game->players.size(); i++)
+		if (game->players[i].ai)
 			return i;
 	return -1;
 }
@@ -174,46 +269,73 @@ void InitKeyboardDevice(GameDevice &keyboardDevice, std::shared_ptr<InputDevice>
 	keyboardDevice.keys_cfg = keys_cfg;
 }
 
-bool KeyboardTestInput(GameDevice &keyboardDevice, int btn_idx, bool(*test)(GameDevice&, hg::Key)) {
-	hg::Key input = keyboard_configs[keyboardDevice.keys_cfg][btn_idx];
-	return test(keyboardDevice, input);
-}
+// devices are polled by the input sampler, the game only reads the snapshot of the frame
+constexpr uint8_t keyboard_debug_f1 = 1 << 3, keyboard_debug_f2 = 1 << 4; // buttons of the keyboard entries after fire, left and right
 
-bool KeyboardInputWasDown(GameDevice &keyboardDevice, int btn_idx) {
-	auto test = [](GameDevice &keyboardDevice, hg::Key btn) {return keyboardDevice.device->WasDown(btn); };
-	return KeyboardTestInput(keyboardDevice, btn_idx, test);
-}
+std::mutex input_device_mutex; // the sampler polls devices while EndFrame updates them
+InputSnapshot input_snapshot;
 
-bool KeyboardInputWasPressed(GameDevice &keyboardDevice, int btn_idx) {
-	auto test = [](GameDevice &keyboardDevice, hg::Key btn) {return keyboardDevice.device->WasPressed(btn); };
-	return KeyboardTestInput(keyboardDevice, btn_idx, test);
-}
+void PollInputDevices(InputDeviceState *states, int count, void *) {
+	std::lock_guard<std::mutex> lock(input_device_mutex);
 
-bool InputDeviceWasButtonPressed(GameDevice &device) {
-	if (device.type == Gamepad) {
-		if (device.device->WasButtonPressed(Button0))
-			return true;
-	} else if (device.type == Keyboard) {
-		if (KeyboardInputWasPressed(device, 0))
-			return true;
+	for (int i = 0; i < count; ++i) // the keyboard backs several entries, update it once
+		if (gamepads[i].device && (i == 0 || gamepads[i].device != gamepads[i - 1].device))
+			gamepads[i].device->Update();
+
+	for (int i = 0; i < count; ++i) {
+		auto &device = gamepads[i];
+		auto &state = states[i];
+		if (!device.device)
+			continue;
+
+		if (device.type == Gamepad) {
+			state.buttons = device.device->IsButtonDown(Button0) ? 1 : 0;
+			state.x = device.device->GetValue(InputAxisX);
+			state.y = device.device->GetValue(InputAxisY);
+		} else if (device.type == Keyboard) {
+			auto &keys = keyboard_configs[device.keys_cfg];
+			for (int b = 0; b < 3; ++b) // fire, turn left, turn right
+				if (device.device->IsDown(keys[b]))
+					state.buttons |= 1 << b;
+
+			if (device.device->IsDown(KeyF1)) // debug keys, on every keyboard layout
+				state.buttons |= keyboard_debug_f1;
+			if (device.device->IsDown(KeyF2))
+				state.buttons |= keyboard_debug_f2;
+		}
 	}
-	return false;
 }
 
-float InputDeviceGetAngle(GameDevice &device) {
+InputSampler input_sampler(&PollInputDevices, nullptr, int(gamepads.size()));
+int input_sample_rate{1000}; // Hz, see -input-rate
+
+void TakeInputSnapshot() {
+	if (!input_ready)
+		return;
+	if (!input_sampler.IsRunning())
+		input_sampler.Sample(); // sampled once per frame on the game thread
+	input_sampler.TakeSnapshot(input_snapshot);
+}
+
+bool InputDeviceWasButtonPressed(int pad_idx) { return (input_snapshot.devices[pad_idx].pressed & 1) != 0; }
+
+float InputDeviceGetAngle(int pad_idx) {
+	auto &device = gamepads[pad_idx];
+	auto &state = input_snapshot.devices[pad_idx];
+
 	if (device.type == Gamepad) {
-		Vector2 v{ device.device->GetValue(InputAxisX), device.device->GetValue(InputAxisY) };
+		Vector2 v{state.x, state.y};
 		auto l = v.Len();
 
 		if (l > 0.25f) {
 			v /= l;
-			device.angle = atan2(v.y, v.x);
+			device.angle = DetAtan2(v.y, v.x);
 		}
 	} else if (device.type == Keyboard) {
-		if (KeyboardInputWasDown(device, 1))
+		if (state.down & 2)
 			device.angle -= 0.2f;
 
-		if (KeyboardInputWasDown(device, 2))
+		if (state.down & 4)
 			device.angle += 0.2f;
 	}
 	return device.angle;
@@ -221,22 +343,28 @@ float InputDeviceGetAngle(GameDevice &device) {
 //
 
 int AnyButtonPressed() {
+	if (!input_ready)
+		return -1;
 	for (size_t i = 0; i < gamepads.size(); ++i)
-		if (InputDeviceWasButtonPressed(gamepads[i]))
+		if ((game->device_mask & (1u << i)) && InputDeviceWasButtonPressed(int(i)))
 			return i;
 	return -1;
 }
 
 std::array<Color, 4> players_color = {Color(238.f / 255.f, 94.f / 255.f, 255.f / 255.f), Color(251.f / 255.f, 220.f / 255.f, 46.f / 255.f), Color(32.f / 255.f, 255.f / 255.f, 63.f / 255.f), Color(36.f / 255.f, 227.f / 255.f, 255.f / 255.f)};
 
+// simulation math goes through det_math.h so that replays and lockstep peers agree
 Vector2 AngleToDirection(float angle) {
-	angle = -angle + Deg(90.f);
-	return {Sin(angle), Cos(angle)};
+	float s, c;
+	DetSinCos(angle, s, c);
+	return {c, s};
 }
 
-float DirectionToAngle(Vector2 dir) {
-	float angle = atan2(dir.y, dir.x);
-	return angle;
+float DirectionToAngle(Vector2 dir) { return DetAtan2(dir.y, dir.x); }
+
+Vector2 DetNormalized(const Vector2 &v) {
+	auto l = DetSqrt(v.x * v.x + v.y * v.y);
+	return l > 0.f ? v * (1.f / l) : v;
 }
 
 time_ns GetAIDelay() { return Rand(ai_max_delay - ai_min_delay) + ai_min_delay; }
@@ -245,41 +373,41 @@ static const char *player_0[] = {"@data:drone_0.png", "@data:drone_1.png", "@dat
 
 float aaa = 0;
 
-void DrawText2DCentered(float x, float y, const std::string &text, float size = 16, Color color = Color::White, const char *font_path = "") {
-	auto rect = g_plus.get().GetTextRect(text, size, font_path);
-	g_plus.get().Text2D(x - rect.GetWidth() / 2, y + rect.GetHeight() / 2, text.c_str(), size, color, font_path);
+void DrawText2DCentered(float x, float y, const char *text, float size = 16, Color color = Color::White, const char *font_path = "") {
+	draw->Text2DCentered(x, y, text, size, color, font_path);
 }
 
-void SetPlayerMessage(Player &player, const char *msg) {
+void SetPlayerMessage(Player &player, const char *msg) { // msg is not copied
 	player.msg = msg;
-	player.msg_delay = time_from_sec(2);
+	game->frame_timers.Cancel(player.msg_timer);
+	player.msg_timer = game->frame_timers.Schedule(time_from_sec(2));
 }
 
 void DrawPlayerMessage(Player &player) {
-	if (player.msg_delay > 0) {
+	auto remaining = game->frame_timers.GetRemaining(player.msg_timer);
+	if (remaining > 0) {
 		float x = player.pos.x, y = player.pos.y + 38.f;
-		auto alpha = Clamp<float>(float(player.msg_delay) / time_from_sec_f(0.2f));
+		auto alpha = Clamp<float>(float(remaining) / time_from_sec_f(0.2f));
 
-		DrawText2DCentered(x, y, player.msg.c_str(), 18.f, Color(0, 0, 0, 0.5f * alpha), "@data:komikax.ttf");
-		DrawText2DCentered(x - 2, y + 2, player.msg.c_str(), 18.f, Color(1, 1, 1, 1 * alpha), "@data:komikax.ttf");
-		player.msg_delay -= GetLastFrameDuration();
+		DrawText2DCentered(x, y, player.msg, 18.f, Color(0, 0, 0, 0.5f * alpha), "@data:komikax.ttf");
+		DrawText2DCentered(x - 2, y + 2, player.msg, 18.f, Color(1, 1, 1, 1 * alpha), "@data:komikax.ttf");
 	}
 }
 
 void DrawPlayer(int idx, const Color &col) {
-	auto &player = players[idx];
+	auto &player = game->players[idx];
 
 	auto shots = GetPlayerShoots(idx);
 
 	if (shots.size() > 0) {
-		g_plus.get().Sprite2D(player.pos.x, player.pos.y, 160.f, "@data:drone_buffer.png", players_color[idx]);
-		g_plus.get().Text2D(player.pos.x - 6.f, player.pos.y - 12.f, format("%1").arg(shots.size()), 32.f, players_color[idx], "@data:impact.ttf");
+		draw->Sprite2D(player.pos.x, player.pos.y, 160.f, "@data:drone_buffer.png", players_color[idx]);
+		draw->Text2D(player.pos.x - 6.f, player.pos.y - 12.f, FrameFormat("%d", int(shots.size())), 32.f, players_color[idx], "@data:impact.ttf");
 	} else {
-		g_plus.get().Sprite2D(player.pos.x, player.pos.y, 160.f, "@data:drone.png", players_color[idx]);
+		draw->Sprite2D(player.pos.x, player.pos.y, 160.f, "@data:drone.png", players_color[idx]);
 	}
 
 	if (shots.size() > 0) {
-		auto &shot = shoots[shots[0]];
+		auto &shot = game->shoots[shots[0]];
 
 		Color tgt_col;
 		if (shot.player_seq_idx == 3) {
@@ -290,23 +418,25 @@ void DrawPlayer(int idx, const Color &col) {
 		}
 
 		auto dir = AngleToDirection(player.angle);
-		g_plus.get().RotatedSprite2D(player.pos.x, player.pos.y, player.angle - Deg(90.f), 160.f, "@data:drone_arrow.png", tgt_col);
+		draw->RotatedSprite2D(player.pos.x, player.pos.y, player.angle - Deg(90.f), 160.f, "@data:drone_arrow.png", tgt_col);
 	}
 }
 
 void PlayerFireShot(int player_idx, int idx) {
-	auto &player = players[player_idx];
-	auto &shot = shoots[idx];
+	auto &player = game->players[player_idx];
+	auto &shot = game->shoots[idx];
 
 	auto dir = AngleToDirection(player.angle);
 	shot.pos = player.pos + dir * player_radius; // prevent self collision
 	shot.spd = dir * shoot_speed;
-	shot.hold_until = 0;
+	shot.held = false;
 	player.spd += shot.spd * player_decoy_coef;
 	__ASSERT__(shot.player_seq_idx < 4);
 	shot.player_seq_idx++;
 
-	g_plus.get().GetMixer()->Start(*piout);
+	TelemetryLog(TelemetryShotFire, player_idx, shot.player_seq_idx, shot.pos.x, shot.pos.y);
+
+	PlaySFX(SfxPiout);
 }
 
 Vector2 GetShootNextTargetPos(const Shoot &shot) {
@@ -314,31 +444,31 @@ Vector2 GetShootNextTargetPos(const Shoot &shot) {
 		return Vector2(width / 2, 0);
 
 	int tgt_idx = shot.player_seq[shot.player_seq_idx + 1];
-	return players[tgt_idx].pos;
+	return game->players[tgt_idx].pos;
 }
 
 void UpdatePlayer(int idx) {
-	auto &player = players[idx];
+	auto &player = game->players[idx];
 
-	player.pos += player.spd;
-	player.spd *= player_damping;
+	player.pos += player.spd * tick_scale;
+	player.spd *= tick_damping;
 
 	if (player.ai) {
 		auto shots = GetPlayerShoots(idx);
 
 		if (shots.size() > 0) {
-			auto &shot = shoots[shots[0]];
+			auto &shot = game->shoots[shots[0]];
 			auto tgt_pos = GetShootNextTargetPos(shot);
 
-			auto dir = (tgt_pos - player.pos).Normalized();
+			auto dir = DetNormalized(tgt_pos - player.pos);
 			player.ai_angle = DirectionToAngle(dir) + FRRand(-ai_precision_delta, ai_precision_delta);
-			player.angle += (player.ai_angle - player.angle) * ai_aiming_speed;
-
-			player.ai_shot_delay -= GetLastFrameDuration();
+			player.angle += (player.ai_angle - player.angle) * tick_aiming;
 
-			if (player.ai_shot_delay < 0) {
+			if (player.ai_shot_ready) {
 				PlayerFireShot(idx, shots[0]);
-				player.ai_shot_delay = GetAIDelay();
+				player.ai_shot_ready = false;
+			} else if (!game->sim_timers.IsPending(player.ai_shot_timer)) {
+				player.ai_shot_timer = game->sim_timers.SetFlag(GetAIDelay(), &player.ai_shot_ready);
 			}
 		}
 	}
@@ -370,13 +500,14 @@ void PlayerCollidePlayfield(Player &player) {
 		sfx = true;
 	}
 
-	if (sfx)
-		g_plus.get().GetMixer()->Start(*bidon, MixerChannelState(0.025f));
+	if (sfx && !player.wall_contact) // once per contact, not per tick
+		PlaySFX(SfxBidon, 0.025f);
+	player.wall_contact = sfx;
 }
 
-void PlayerCollidePlayer(Player &a, Player &b) {
+bool PlayerCollidePlayer(Player &a, Player &b) {
 	auto d = b.pos - a.pos;
-	auto l = d.Len();
+	auto l = DetSqrt(d.x * d.x + d.y * d.y);
 
 	if (l < player_radius * 2) {
 		auto k = (player_radius * 2 - l) * player_to_player_collision_damping;
@@ -384,46 +515,56 @@ void PlayerCollidePlayer(Player &a, Player &b) {
 
 		b.spd += v;
 		a.spd -= v;
-
-		g_plus.get().GetMixer()->Start(*bidon, MixerChannelState(0.025f));
+		return true;
 	}
+	return false;
 }
 
 void UpdatePlayersCollision() {
-	for (size_t i = 0; i < players.size(); ++i)
-		for (size_t j = 0; j < players.size(); ++j)
-			if (i != j)
-				PlayerCollidePlayer(players[i], players[j]);
+	uint16_t contacts = 0;
+	for (size_t i = 0; i < game->players.size(); ++i)
+		for (size_t j = 0; j < game->players.size(); ++j)
+			if (i != j && PlayerCollidePlayer(game->players[i], game->players[j]))
+				contacts |= 1 << (std::min(i, j) * 4 + std::max(i, j)); // one bit per pair
+
+	if (contacts & ~game->player_contacts) // once per contact, not per tick
+		PlaySFX(SfxBidon, 0.025f);
+	game->player_contacts = contacts;
 
-	for (auto &player : players)
+	for (auto &player : game->players)
 		PlayerCollidePlayfield(player);
 }
 
-void UpdatePlayerInputs(int idx, GameDevice &device) {
-	auto &player = players[idx];
+void UpdatePlayerInputs(int idx, int pad_idx) {
+	auto &player = game->players[idx];
 
 	if (!player.ai) {
-		player.angle = InputDeviceGetAngle(device);
+		player.angle = InputDeviceGetAngle(pad_idx);
 
-		if (InputDeviceWasButtonPressed(device)) {
+		if (InputDeviceWasButtonPressed(pad_idx)) {
 			auto shots = GetPlayerShoots(idx);
-			if (shots.size() > 0)
+			if (shots.size() > 0) {
+				LatencyTrace trace{input_snapshot.devices[pad_idx].press_time[0], InputClock(), 0, uint8_t(gamepads[pad_idx].type), false};
+				auto mixer_starts = mixer_start_count;
+
 				PlayerFireShot(idx, shots[0]);
+
+				trace.fire = InputClock();
+				trace.sound = mixer_start_count != mixer_starts;
+				draw->AddLatencyTrace(trace); // completed when the frame is shown
+			}
 		}
 	}
 }
 
-//
-std::function<bool()> game_state, next_game_state;
-
 //
 bool GameInit();
 bool GameLoop();
 bool Title();
 
 void ShootAtTarget(Shoot &shoot, const Vector2 &tgt) {
-	shoot.spd = (tgt - shoot.pos).Normalized() * shoot_speed;
-	shoot.hold_until = 0;
+	shoot.spd = DetNormalized(tgt - shoot.pos) * shoot_speed;
+	shoot.held = false;
 }
 
 void InitShoot(Shoot &shoot) {
@@ -439,50 +580,46 @@ void InitShoot(Shoot &shoot) {
 
 	shoot.player_seq_idx = 0;
 	shoot.pos = Vector2(width / 2, 0);
-	shoot.hold_until = 0;
+	shoot.held = false;
 
-	ShootAtTarget(shoot, players[shoot.player_seq[shoot.player_seq_idx]].pos);
+	ShootAtTarget(shoot, game->players[shoot.player_seq[shoot.player_seq_idx]].pos);
 }
 
-std::vector<int> GetPlayerShoots(int idx) {
-	std::vector<int> shoot_idxs;
-	for (size_t i = 0; i < shoots.size(); ++i) {
-		auto &shoot = shoots[i];
-		if (shoot.hold_until && (shoot.player_seq[shoot.player_seq_idx] == idx))
+FrameVector<int> GetPlayerShoots(int idx) {
+	FrameVector<int> shoot_idxs;
+	for (size_t i = 0; i < game->shoots.size(); ++i) {
+		auto &shoot = game->shoots[i];
+		if (shoot.held && (shoot.player_seq[shoot.player_seq_idx] == idx))
 			shoot_idxs.push_back(i);
 	}
 	return shoot_idxs;
 }
 
 //
-static std::string earth_msg;
-static time_ns earth_msg_duration{0};
-
 void SetEarthMessage(const char *msg) {
-	earth_msg = msg;
-	earth_msg_duration = time_from_sec(2);
+	game->earth_msg = msg;
+	game->frame_timers.Cancel(game->earth_msg_timer);
+	game->earth_msg_timer = game->frame_timers.Schedule(time_from_sec(2));
 }
 
 Vector2 GetEarthPos() { return Vector2(width / 2.f, height - 120.f); }
 
 void DrawEarthMessage() {
-	if (earth_msg_duration > 0) {
+	auto remaining = game->frame_timers.GetRemaining(game->earth_msg_timer);
+	if (remaining > 0) {
 		auto pos = GetEarthPos();
-		auto alpha = Clamp<float>(float(earth_msg_duration) / time_from_sec_f(0.2f));
+		auto alpha = Clamp<float>(float(remaining) / time_from_sec_f(0.2f));
 
-		DrawText2DCentered(pos.x, pos.y, earth_msg.c_str(), 64.f, Color(0, 0, 0, 0.75f * alpha), "@data:komikax.ttf");
-		DrawText2DCentered(pos.x - 8, pos.y + 8, earth_msg.c_str(), 64.f, Color(1, 1, 1, 1 * alpha), "@data:komikax.ttf");
-		earth_msg_duration -= GetLastFrameDuration();
+		DrawText2DCentered(pos.x, pos.y, game->earth_msg, 64.f, Color(0, 0, 0, 0.75f * alpha), "@data:komikax.ttf");
+		DrawText2DCentered(pos.x - 8, pos.y + 8, game->earth_msg, 64.f, Color(1, 1, 1, 1 * alpha), "@data:komikax.ttf");
 	}
 }
 
 //
-static std::string alien_msg;
-static time_ns alien_msg_duration{0};
-
 void SetAlienMessage(const char *msg) {
-	alien_msg = msg;
-	alien_msg_duration = time_from_sec(2);
+	game->alien_msg = msg;
+	game->frame_timers.Cancel(game->alien_msg_timer);
+	game->alien_msg_timer = game->frame_timers.Schedule(time_from_sec(2));
 }
 
 Vector2 GetAlienPos() { 
@@ -496,13 +633,13 @@ Vector2 GetAlienPos() {
 }
 
 void DrawAlienMessage() { 
-	if (alien_msg_duration > 0) {
+	auto remaining = game->frame_timers.GetRemaining(game->alien_msg_timer);
+	if (remaining > 0) {
 		auto pos = GetAlienPos();
-		auto alpha = Clamp<float>(float(alien_msg_duration) / time_from_sec_f(0.2f));
+		auto alpha = Clamp<float>(float(remaining) / time_from_sec_f(0.2f));
 
-		DrawText2DCentered(pos.x, pos.y, alien_msg.c_str(), 64.f, Color(0, 0, 0, 0.75f * alpha), "@data:komikax.ttf");
-		DrawText2DCentered(pos.x - 8, pos.y + 8, alien_msg.c_str(), 64.f, Color(1, 0, 0, 1 * alpha), "@data:komikax.ttf");
-		alien_msg_duration -= GetLastFrameDuration();
+		DrawText2DCentered(pos.x, pos.y, game->alien_msg, 64.f, Color(0, 0, 0, 0.75f * alpha), "@data:komikax.ttf");
+		DrawText2DCentered(pos.x - 8, pos.y + 8, game->alien_msg, 64.f, Color(1, 0, 0, 1 * alpha), "@data:komikax.ttf");
 	}
 }
 
@@ -512,33 +649,59 @@ void SpawnBloodSplatFX(const Vector2 &pos, const char *path) {
 		SpawnFX(pos.x + FRRand(-width * 0.5f, width * 0.5f), pos.y + FRRand(-20.f, 20.f), path, FRRand(200, 600), FRRand(0, 2), time_from_sec(1), time_from_sec_f(FRRand(0, 1)));
 }
 
+// first time in [0;1] at which a circle moving from pos by delta comes within radius of center
+bool SweptCircleHit(const Vector2 &pos, const Vector2 &delta, const Vector2 &center, float radius, float &t) {
+	auto fx = pos.x - center.x, fy = pos.y - center.y;
+	auto c = fx * fx + fy * fy - radius * radius;
+
+	if (c < 0.f) { // overlapping from the start
+		t = 0.f;
+		return true;
+	}
+
+	auto a = delta.x * delta.x + delta.y * delta.y;
+	if (a == 0.f)
+		return false;
+
+	auto b = fx * delta.x + fy * delta.y;
+	auto disc = b * b - a * c;
+	if (b >= 0.f || disc < 0.f) // moving away or missing
+		return false;
+
+	t = (-b - DetSqrt(disc)) / a;
+	return t <= 1.f;
+}
+
 //
 void UpdateShoot(int idx) {
-	auto &shoot = shoots[idx];
+	auto &shoot = game->shoots[idx];
 
 	bool out_of_bound = false;
 
-	if (shoot.hold_until == 0) {
-		shoot.pos += shoot.spd;
+	if (!shoot.held) {
+		auto delta = shoot.spd * tick_scale;
 
-		// detect drone collision
-		for (int i = 0; i < 4; ++i) {
-			auto &player = players[i];
-			if (Vector2::Dist(shoot.pos, player.pos) < (shoot_radius + player_radius)) {
-				bool correct_transfer = true;
+		// detect the capture over the whole step, only the next drone in the sequence captures the shot
+		int hit_idx = -1;
+		float hit_t = 0.f;
 
-				if (shoot.player_seq_idx == 4) // alien expected
-					correct_transfer = false;
-				else
-					correct_transfer = i == shoot.player_seq[shoot.player_seq_idx];
+		if (shoot.player_seq_idx < 4) { // not when the alien is expected
+			auto tgt_idx = shoot.player_seq[shoot.player_seq_idx];
+			if (SweptCircleHit(shoot.pos, delta, game->players[tgt_idx].pos, shoot_radius + player_radius, hit_t))
+				hit_idx = tgt_idx;
+		}
 
-				if (correct_transfer) {
-					shoot.hold_until = shoot_hold_duration;
-					player.spd += shoot.spd * shoot_to_player_transfer_coef;
+		if (hit_idx != -1) {
+			auto &player = game->players[hit_idx];
 
-					SpawnFX(player.pos.x, player.pos.y, "@data:fx_donut.png", 200.f, 0, time_from_sec_f(0.2f), 0, Color(1, 1, 1, 0.75f), 8.f);
-				}
-			}
+			shoot.pos += delta * hit_t;
+			shoot.held = true;
+			player.spd += shoot.spd * shoot_to_player_transfer_coef;
+
+			SpawnFX(player.pos.x, player.pos.y, "@data:fx_donut.png", 200.f, 0, time_from_sec_f(0.2f), 0, Color(1, 1, 1, 0.75f), 8.f);
+			TelemetryLog(TelemetryShotCapture, hit_idx, shoot.player_seq_idx, shoot.pos.x, shoot.pos.y);
+		} else {
+			shoot.pos += delta;
 		}
 
 		// detect out of playfield
@@ -558,138 +721,121 @@ void UpdateShoot(int idx) {
 		if (out_of_bound == true) {
 			if (shoot.player_seq_idx == 0) { // initial alien shot
 				SetAlienMessage("Human escape!");
-				g_plus.get().GetMixer()->Start(*piout);
+				PlaySFX(SfxPiout);
+				TelemetryLog(TelemetryHumanEscape, 0, 0, shoot.pos.x, shoot.pos.y);
 			} else if (shoot.player_seq_idx == 4) { // last human shot
 				if (could_hit_alien) {
-					SetPlayerMessage(players[shoot.player_seq[3]], "Humanity hero!");
+					SetPlayerMessage(game->players[shoot.player_seq[3]], "Humanity hero!");
 					SetAlienMessage("Sufffering!");
 					SpawnBloodSplatFX(GetAlienPos(), "@data:alien_blood.png");
 					ShakeBG(10.f);
-					alien_health -= 5;
-					g_plus.get().GetMixer()->Start(*tako);
+					game->alien_health -= alien_hit_damage;
+					PlaySFX(SfxTako);
+					TelemetryLog(TelemetryAlienHit, shoot.player_seq[3], alien_hit_damage, shoot.pos.x, shoot.pos.y);
 				} else {
-					SetPlayerMessage(players[shoot.player_seq[3]], "You drunkard!");
+					SetPlayerMessage(game->players[shoot.player_seq[3]], "You drunkard!");
 					SetAlienMessage("Alien missed!");
 					SetEarthMessage("Genocide!");
 					SpawnBloodSplatFX(GetEarthPos(), "@data:human_blood.png");
 					ShakeBG(10.f);
-					human_health -= 10;
-					g_plus.get().GetMixer()->Start(*explosion);
+					game->human_health -= alien_miss_damage;
+					PlaySFX(SfxExplosion);
+					TelemetryLog(TelemetryAlienMiss, shoot.player_seq[3], alien_miss_damage, shoot.pos.x, shoot.pos.y);
 				}
 			} else {
-				SetPlayerMessage(players[shoot.player_seq[shoot.player_seq_idx - 1]], "Chain breaker!");
+				SetPlayerMessage(game->players[shoot.player_seq[shoot.player_seq_idx - 1]], "Chain breaker!");
 				SpawnBloodSplatFX(GetEarthPos(), "@data:human_blood.png");
 				SetEarthMessage("Cataclysm!");
 				ShakeBG(4.f);
-				human_health -= 5;
-				g_plus.get().GetMixer()->Start(*explosion);
+				game->human_health -= chain_break_damage;
+				PlaySFX(SfxExplosion);
+				TelemetryLog(TelemetryChainBreak, shoot.player_seq[shoot.player_seq_idx - 1], chain_break_damage, shoot.pos.x, shoot.pos.y);
 			}
 		}
 	}
 
 	if (out_of_bound)
-		shoots.erase(shoots.begin() + idx);
+		game->shoots.erase(game->shoots.begin() + idx);
 }
 
 void UpdateShoots() {
-	for (size_t i = 0; i < shoots.size(); ++i)
+	for (size_t i = 0; i < game->shoots.size(); ++i)
 		UpdateShoot(i);
 }
 
 void DrawShoot(Shoot &shoot) {
-	if (shoot.hold_until == 0)
-		g_plus.get().RotatedSprite2D(shoot.pos.x, shoot.pos.y, DirectionToAngle(shoot.spd), 150.f, "@data:drone_shoot.png", Color::White, 93.f / 150.f, 0.5f);
+	if (!shoot.held)
+		draw->RotatedSprite2D(shoot.pos.x, shoot.pos.y, DirectionToAngle(shoot.spd), 150.f, "@data:drone_shoot.png", Color::White, 93.f / 150.f, 0.5f);
 }
 
 void DrawShoots() {
-	for (auto &shoot : shoots)
+	for (auto &shoot : game->shoots)
 		DrawShoot(shoot);
 }
 
 //
 void SpawnShoot() {
 	SetAlienMessage("Attack!");
-	shoots.emplace_back();
-	InitShoot(shoots.back());
+	game->shoots.emplace_back();
+	InitShoot(game->shoots.back());
+
+	TelemetryLog(TelemetryShotSpawn, game->shoots.back().player_seq[0]);
 }
 
 //
-time_ns next_shoot_delay = 0;
-
-void HeuristicSpawnShoot() {
-	next_shoot_delay -= GetLastFrameDuration();
-	if (next_shoot_delay < 0) {
-		next_shoot_delay = time_from_sec_f(FRRand(1.f, 3.5f));
-		SpawnShoot();
-	}
+void HeuristicSpawnShoot(void *) { // sim timer callback
+	game->sim_timers.Schedule(StepsFromSec(FRRand(shoot_spawn_min_delay, shoot_spawn_max_delay)) * sim_reference_step, &HeuristicSpawnShoot);
+	SpawnShoot();
 }
 
 //
 void DrawHealthBar(float x, float y, int health) {
 	int idx = Clamp<int>(((health + 9) / 10), 0, 10) * 10;
-	auto path = format("@data:life_bar_%1.png").arg(idx).str();
-	g_plus.get().Image2D(x, y, 1, path.c_str());
+	draw->Image2D(x, y, 1, FrameFormat("@data:life_bar_%d.png", idx));
 }
 
 void DrawUI() {
-	g_plus.get().Sprite2D(80, height - 200, 120.f, "@data:alien_avatar.png");
-	g_plus.get().Sprite2D(width - 80, height - 200, 120.f, "@data:human_avatar.png");
+	draw->Sprite2D(80, height - 200, 120.f, "@data:alien_avatar.png");
+	draw->Sprite2D(width - 80, height - 200, 120.f, "@data:human_avatar.png");
 
-	DrawHealthBar(80 + 40, height - 200, alien_health);
-	DrawHealthBar(width - 80 - 40 - 230, height - 200, human_health);
+	DrawHealthBar(80 + 40, height - 200, game->alien_health);
+	DrawHealthBar(width - 80 - 40 - 230, height - 200, game->human_health);
 
-	for (auto &player : players)
+	for (auto &player : game->players)
 		DrawPlayerMessage(player);
 
 	DrawEarthMessage();
 	DrawAlienMessage();
 }
 
-float bg_shake_strength = 0.f;
-
-void ShakeBG(float strength) { bg_shake_strength = strength; }
+void ShakeBG(float strength) { game->bg_shake_strength = strength; }
 
 void DrawBG() {
 	float shake_offx = FRRand(-1.f, 1.f), shake_offy = FRRand(-1.f, 1.f);
-	g_plus.get().Image2D(shake_offx * bg_shake_strength, shake_offy * bg_shake_strength, 1, "@data:space_bg.jpg");
-	bg_shake_strength *= 0.95f;
+	draw->Image2D(shake_offx * game->bg_shake_strength, shake_offy * game->bg_shake_strength, 1, "@data:space_bg.jpg");
+	game->bg_shake_strength *= 0.95f;
 
 	float a = time_to_sec_f(g_plus.get().GetClock());
-	float alien_x = Cos(a * 0.75f) * 25.f;
+	float alien_x = DetCos(a * 0.75f) * 25.f;
 
-	g_plus.get().Image2D(alien_x, float(-(100 - alien_health)), 1, "@data:tentacles.png");
+	draw->Image2D(alien_x, float(-(100 - game->alien_health)), 1, "@data:tentacles.png");
 }
 
-struct FX {
-	std::string img;
-	Vector2 pos;
-	float size;
-	float rotation;
-	time_ns delay;
-	time_ns duration;
-	Color color;
-	float size_spd;
-};
-
-std::vector<FX> fxs;
-
 void DrawFXs() {
 	auto k_fade = time_from_sec_f(0.25f);
+	auto now = game->frame_timers.GetNow();
 
-	for (auto &fx : fxs) {
-		if (fx.delay > 0) {
-			fx.delay -= GetLastFrameDuration();
-		} else {
-			auto alpha = Clamp<float>(float(fx.duration) / k_fade);
+	for (auto &fx : game->fxs) {
+		if (now >= fx.start) {
+			auto alpha = Clamp<float>(float(fx.end - now) / k_fade);
 			auto col = fx.color;
 			col.a *= alpha;
-			g_plus.get().RotatedSprite2D(fx.pos.x, fx.pos.y, fx.rotation, fx.size, fx.img.c_str(), col);
+			draw->RotatedSprite2D(fx.pos.x, fx.pos.y, fx.rotation, fx.size, fx.img, col);
 			fx.size += fx.size_spd;
-			fx.duration -= GetLastFrameDuration();
 		}
 	}
 
-	fxs.erase(std::remove_if(fxs.begin(), fxs.end(), [](const FX &fx) { return fx.duration < 0; }), fxs.end());
+	game->fxs.erase(std::remove_if(game->fxs.begin(), game->fxs.end(), [now](const FX &fx) { return fx.end < now; }), game->fxs.end());
 }
 
 void SpawnFX(float x, float y, const char *img, float size, float rotation, time_ns duration, time_ns delay, Color color, float size_spd) {/////
@@ -698,39 +844,38 @@ void SpawnFX(float x, float y, const char *img, float size, float rotation, time
 	fx.pos = Vector2(x, y);
 	fx.size = size;
 	fx.rotation = rotation;
-	fx.delay = delay;
-	fx.duration = duration;
+	fx.start = game->frame_timers.GetNow() + delay;
+	fx.end = fx.start + duration;
 	fx.color = color;
 	fx.size_spd = size_spd;
-	fxs.push_back(fx);
+	game->fxs.push_back(fx);
 }
 
 //
-Color fade_color(0, 0, 0, 0), fade_to;
-time_ns fade_duration, fade_t;
-
 void FullscreenQuad(const Color &color) {
-	g_plus.get().Quad2D(0, 0, 0, height, width, height, width, 0, color, color, color, color);
+	draw->Quad2D(0, 0, 0, height, width, height, width, 0, color, color, color, color);
 }
 
-bool IsFading() { return fade_duration > 0; } 
+bool IsFading() { return game->frame_timers.IsPending(game->fade_timer); } 
 
 void FadeTo(const Color &col, time_ns duration) { 
-	fade_to = col;
-	fade_t = fade_duration = duration;
+	game->fade_to = col;
+	game->fade_t = duration;
+	game->frame_timers.Cancel(game->fade_timer);
+	game->fade_timer = game->frame_timers.Schedule(duration);
 }
 
-void SetFade(const Color &col) { fade_color = col; } 
+void SetFade(const Color &col) { game->fade_color = col; } 
 
 void DrawFade() {
 	Color col;
 
-	if (fade_duration > 0) {
-		auto k = time_to_sec_f(fade_duration) / time_to_sec_f(fade_t);
-		col = fade_color * k + fade_to * (1.f - k);
-		fade_duration -= GetLastFrameDuration();
+	auto remaining = game->frame_timers.GetRemaining(game->fade_timer);
+	if (remaining > 0) {
+		auto k = time_to_sec_f(remaining) / time_to_sec_f(game->fade_t);
+		col = game->fade_color * k + game->fade_to * (1.f - k);
 	} else {
-		col = fade_color = fade_to;
+		col = game->fade_color = game->fade_to;
 	}
 
 	if (col.a)
@@ -738,11 +883,9 @@ void DrawFade() {
 }
 
 //
-std::string game_over_img;
-
 void DrawGameOver() {
-	g_plus.get().Image2D(0, 0, 1, "@data:default_screen.jpg");
-	g_plus.get().Image2D(0, 550, 1, game_over_img.c_str());
+	draw->Image2D(0, 0, 1, "@data:default_screen.jpg");
+	draw->Image2D(0, 550, 1, game->game_over_img);
 }
 
 bool GameOverFade() {
@@ -751,7 +894,7 @@ bool GameOverFade() {
 	if (IsFading())
 		return false;
 
-	next_game_state = &Title;
+	game->next_game_state = &Title;
 	return true;
 }
 
@@ -761,75 +904,188 @@ bool GameOver() {
 	if (!IsFading() && AnyButtonPressed() != -1) {
 		SetFade(Color(0, 0, 0, 0));
 		FadeTo(Color::Black, time_from_sec(1));
-		next_game_state = &GameOverFade;
+		game->next_game_state = &GameOverFade;
 		return true;
 	}
 	return false;
 }
 
-//
-void GameLoopCommon() {
-	DrawBG();
+// heap allocations per game loop stage
+enum AllocStage { AllocDrawBG, AllocCollision, AllocPlayers, AllocSpawn, AllocShoots, AllocDraw, AllocStageCount };
+
+static const char *alloc_stage_names[AllocStageCount] = {"DrawBG", "Collision", "Players", "Spawn", "Shoots", "Draw"};
+
+std::array<AllocStats, AllocStageCount> alloc_stages;
+AllocStats alloc_frames;
+int alloc_frame_count{0};
+
+void ReportFrameAllocs(AllocStats frame) {
+	alloc_frames += frame;
+
+	if (++alloc_frame_count < 600)
+		return;
+
+	log(format("Allocations per frame: %1 (%2 bytes)").arg(alloc_frames.count / alloc_frame_count).arg(alloc_frames.bytes / alloc_frame_count));
+	for (int i = 0; i < AllocStageCount; ++i)
+		if (alloc_stages[i].count)
+			log(format("    %1: %2 (%3 bytes)").arg(alloc_stage_names[i]).arg(alloc_stages[i].count / alloc_frame_count).arg(alloc_stages[i].bytes / alloc_frame_count));
+
+	if (auto overflow = g_frame_arena.TakeOverflowCount())
+		warn(format("Frame arena overflowed %1 times (capacity %2 bytes)").arg(overflow).arg(g_frame_arena.GetCapacity()));
+	log(format("Frame arena peak: %1 bytes").arg(g_frame_arena.GetPeak()));
 
-	UpdatePlayersCollision();
+	alloc_stages.fill({});
+	alloc_frames = {};
+	alloc_frame_count = 0;
+}
 
-	for (size_t i = 0; i < players.size(); ++i) {
-		int playerGamepadIdx = players[i].gamepad;
+//
+void UpdatePlayersInputs() {
+	for (size_t i = 0; i < game->players.size(); ++i) {
+		int playerGamepadIdx = game->players[i].gamepad;
 		if (playerGamepadIdx != -1)
-			UpdatePlayerInputs(i, gamepads[players[i].gamepad]);
-		UpdatePlayer(i);
-		DrawPlayer(i, players_color[i]);
+			UpdatePlayerInputs(i, playerGamepadIdx);
+	}
+}
+
+void GameTick(time_ns dt) {
+	FrameArenaScope arena_scope; // a tick keeps nothing in the frame arena, ticks run outside of the frame loop do not grow it
+	tick_scale = float(double(dt) / double(sim_reference_step));
+	++tick_count;
+
+	// libm pow is only used off the reference rate, lockstep peers must run at the same rate anyway
+	if (dt != sim_reference_step) {
+		tick_damping = std::pow(player_damping, tick_scale);
+		tick_aiming = 1.f - std::pow(1.f - ai_aiming_speed, tick_scale);
+	} else {
+		tick_damping = player_damping;
+		tick_aiming = ai_aiming_speed;
 	}
 
-	HeuristicSpawnShoot();
-	UpdateShoots();
+	{
+		AllocScope scope(alloc_stages[AllocCollision]);
+		UpdatePlayersCollision();
+	}
+
+	{
+		AllocScope scope(alloc_stages[AllocPlayers]);
+		for (size_t i = 0; i < game->players.size(); ++i)
+			UpdatePlayer(i);
+	}
+
+	{
+		AllocScope scope(alloc_stages[AllocSpawn]);
+		game->sim_timers.Advance(dt); // shot spawns and AI fire delays
+	}
+
+	{
+		AllocScope scope(alloc_stages[AllocShoots]);
+		UpdateShoots();
+	}
+}
+
+// collision radii and aim of the drones and shots, see -debug-overlay
+bool debug_overlay{false};
+
+void DrawDebugOverlay() {
+	for (size_t i = 0; i < game->players.size(); ++i) {
+		auto &player = game->players[i];
+		DrawCircle(player.pos.x, player.pos.y, player_radius, 32, players_color[i]);
+
+		auto dir = AngleToDirection(player.angle);
+		draw->Line2D(player.pos.x, player.pos.y, player.pos.x + dir.x * player_radius * 2.f, player.pos.y + dir.y * player_radius * 2.f, players_color[i], Color(1, 1, 1, 0));
+	}
+
+	for (auto &shoot : game->shoots)
+		if (!shoot.held) {
+			DrawDisc(shoot.pos.x, shoot.pos.y, shoot_radius, 12, Color(1, 0, 0, 0.4f));
+			DrawCircle(shoot.pos.x, shoot.pos.y, shoot_radius + player_radius, 24, Color(1, 0, 0, 0.6f)); // hit when a drone center gets in
+		}
+}
+
+void GameDraw() {
+	AllocScope scope(alloc_stages[AllocDraw]);
+
+	for (size_t i = 0; i < game->players.size(); ++i)
+		DrawPlayer(i, players_color[i]);
+
 	DrawShoots();
 
 	DrawFXs();
 	DrawUI();
+
+	if (debug_overlay)
+		DrawDebugOverlay();
 }
 
-bool attract_mode{false};
-time_ns attract_mode_duration{0};
+void GameLoopCommon() {
+	{
+		AllocScope scope(alloc_stages[AllocDrawBG]);
+		DrawBG();
+	}
+
+	{
+		AllocScope scope(alloc_stages[AllocPlayers]);
+		UpdatePlayersInputs(); // once per frame, presses are not replayed by each tick
+	}
+
+	game->sim_accumulator = std::min(game->sim_accumulator + GetFrameDuration(), sim_step * 4); // do not spiral after a long frame
+	while (game->sim_accumulator >= sim_step) {
+		GameTick(sim_step);
+		game->sim_accumulator -= sim_step;
+	}
+
+	GameDraw();
+}
 
 bool GameInit() {
-	fxs.clear();
-	shoots.clear();
+	game->fxs.clear();
+	game->shoots.clear();
+	game->sim_accumulator = 0;
+	game->sim_timers.Clear();
+	game->player_contacts = 0;
+
+	// keep the steady state free of reallocations
+	game->fxs.reserve(256);
+	game->shoots.reserve(64);
 
-	earth_msg_duration = 0;
-	alien_msg_duration = 0;
+	game->frame_timers.Cancel(game->earth_msg_timer);
+	game->frame_timers.Cancel(game->alien_msg_timer);
 
-	for (auto &player : players) {
+	for (auto &player : game->players) {
 		player.pos = {FRRand(100, 620), FRRand(400, 800)};
 		player.spd = {FRRand(-0.1f, 0.1f), FRRand(-0.1f, 0.1f)};
 		player.angle = FRand(Deg(360.f));
-		player.ai_shot_delay = GetAIDelay();
-		player.msg_delay = 0;
+		player.ai_shot_timer = {};
+		player.ai_shot_ready = false;
+		player.wall_contact = false;
+		game->frame_timers.Cancel(player.msg_timer);
 	}
 
-	human_health = 100;
-	alien_health = 100;
+	game->human_health = 100;
+	game->alien_health = 100;
 
-	next_game_state = &GameLoop;
-	next_shoot_delay = time_from_sec(3);
+	game->next_game_state = &GameLoop;
+	game->sim_timers.Schedule(StepsFromSec(first_shoot_delay) * sim_reference_step, &HeuristicSpawnShoot);
 
 	SetAlienMessage("GraaawwwR!");
 
 	SetFade(Color::Black);
 	FadeTo(Color(0, 0, 0, 0));
 
-	attract_mode = false;
+	game->attract_mode = false;
 	return true;
 }
 
 bool AttractMode() {
-	for (auto &player : players)
+	for (auto &player : game->players)
 		player.ai = true;
 
 	GameInit();
 
-	attract_mode = true;
-	attract_mode_duration = time_from_sec(20);
+	game->attract_mode = true;
+	game->frame_timers.Cancel(game->attract_mode_timer);
+	game->attract_mode_timer = game->frame_timers.Schedule(time_from_sec(20));
 
 	SetFade(Color::White);
 	FadeTo(Color(1, 1, 1, 0));
@@ -837,17 +1093,24 @@ bool AttractMode() {
 }
 
 void GameDebugKeys() {
-	if (g_plus.get().KeyDown(KeyF1))
-		human_health = 0;
-	if (g_plus.get().KeyDown(KeyF2))
-		alien_health = 0;
+	if (!input_ready)
+		return;
+
+	uint8_t down = 0;
+	for (size_t i = 0; i < gamepads.size(); ++i)
+		if (gamepads[i].type == Keyboard && (game->device_mask & (1u << i)))
+			down |= input_snapshot.devices[i].down;
+
+	if (down & keyboard_debug_f1)
+		game->human_health = 0;
+	if (down & keyboard_debug_f2)
+		game->alien_health = 0;
 }
 
 bool GameLoop() {
-	if (attract_mode) {
-		attract_mode_duration -= GetLastFrameDuration();
-		if (attract_mode_duration < 0 || human_health < 10 || alien_health < 10 || (AnyButtonPressed() != -1)) {
-			next_game_state = Title;
+	if (game->attract_mode) {
+		if (!game->frame_timers.IsPending(game->attract_mode_timer) || game->human_health < 10 || game->alien_health < 10 || (AnyButtonPressed() != -1)) {
+			game->next_game_state = Title;
 			return true;
 		}
 	}
@@ -855,104 +1118,167 @@ bool GameLoop() {
 	GameLoopCommon();
 	GameDebugKeys();
 
-	if (alien_health <= 0) {
+	if (game->alien_health <= 0) {
 		SetFade(Color::Blue);
 		FadeTo(Color(1, 0, 0, 0), time_from_sec(3));
-		game_over_img = "@data:victory_text.png";
-		next_game_state = &GameOver;
+		game->game_over_img = "@data:victory_text.png";
+		game->next_game_state = &GameOver;
 		return true;
-	} else if (human_health <= 0) {
+	} else if (game->human_health <= 0) {
 		SetFade(Color::Red);
 		FadeTo(Color(1, 0, 0, 0), time_from_sec(3));
-		game_over_img = "@data:game_over_text.png";
-		next_game_state = &GameOver;
+		game->game_over_img = "@data:game_over_text.png";
+		game->next_game_state = &GameOver;
 		return true;
 	}
 
-	if (attract_mode)
-		if ((attract_mode_duration % time_from_sec_f(1)) > time_from_sec_f(0.5f))
-			g_plus.get().Image2D(0, 80, 1, "@data:press_any_button_text.png");
+	if (game->attract_mode)
+		if ((game->frame_timers.GetRemaining(game->attract_mode_timer) % time_from_sec_f(1)) > time_from_sec_f(0.5f))
+			draw->Image2D(0, 80, 1, "@data:press_any_button_text.png");
 
 	return false;
 }
 
 //
-bool DetectGameStart();
+// stress mode: an AI only match that never ends while the load grows until frames go over budget
+StressRamp stress_ramp;
+float stress_shots_per_sec{4.f}, stress_splats_per_sec{1.f}, stress_msgs_per_sec{8.f}; // at level 1, see -stress-load
+
+bool StressLoop();
+
+bool StressInit() {
+	for (auto &player : game->players)
+		player.ai = true;
+
+	GameInit();
+
+	game->stress_shots_due = game->stress_splats_due = game->stress_msgs_due = 0.f;
+	game->next_game_state = &StressLoop;
+
+	log(format("Stress: ramping to %1ms frames, %2 shots/s, %3 splat bursts/s, %4 messages/s per level").arg(stress_ramp.GetTargetMs()).arg(stress_shots_per_sec).arg(stress_splats_per_sec).arg(stress_msgs_per_sec));
+	return true;
+}
+
+void GenerateStressLoad() {
+	static const char *msgs[] = {"Stress!", "Overload!", "Too many!", "Help!"};
+
+	auto dt = time_to_sec_f(GetFrameDuration());
+	auto level = stress_ramp.GetLevel();
+
+	game->stress_shots_due += stress_shots_per_sec * level * dt;
+	game->stress_splats_due += stress_splats_per_sec * level * dt;
+	game->stress_msgs_due += stress_msgs_per_sec * level * dt;
+
+	// spawned shots go through the drone chains, collision and alien hit code like the heuristic ones
+	for (; game->stress_shots_due >= 1.f; game->stress_shots_due -= 1.f)
+		SpawnShoot();
 
-time_ns how_to_play_time;
-bool how_to_play_can_start_game;
-std::function<bool()> how_to_play_branch_to;
+	for (; game->stress_splats_due >= 1.f; game->stress_splats_due -= 1.f)
+		SpawnBloodSplatFX(Rand(2) ? GetAlienPos() : GetEarthPos(), Rand(2) ? "@data:alien_blood.png" : "@data:human_blood.png");
+
+	for (; game->stress_msgs_due >= 1.f; game->stress_msgs_due -= 1.f)
+		SetPlayerMessage(game->players[Rand(int(game->players.size()))], msgs[Rand(4)]);
+}
+
+bool StressLoop() {
+	game->human_health = game->alien_health = 100; // the match must outlive the ramp
+
+	GenerateStressLoad();
+	GameLoopCommon();
+
+	auto level = stress_ramp.GetLevel();
+	if (game == &instances[0] && stress_ramp.Update(time_to_ms_f(GetLastFrameDuration()))) { // every instance carries the load, the frame is measured once
+		log(format("Stress: level %1 (%2 shots/s, %3 splat bursts/s, %4 messages/s), %5ms, %6 shots and %7 FX live").arg(level).arg(stress_shots_per_sec * level)
+			.arg(stress_splats_per_sec * level).arg(stress_msgs_per_sec * level).arg(stress_ramp.GetStepMs()).arg(int(game->shoots.size())).arg(int(game->fxs.size())));
+
+		if (stress_ramp.IsDone()) {
+			auto sustained = stress_ramp.GetSustainedLevel();
+			if (sustained > 0.f)
+				log(format("Stress: highest sustained load is level %1: %2 shots/s, %3 splat bursts/s, %4 messages/s within %5ms").arg(sustained).arg(stress_shots_per_sec * sustained)
+					.arg(stress_splats_per_sec * sustained).arg(stress_msgs_per_sec * sustained).arg(stress_ramp.GetTargetMs()));
+			else
+				warn(format("Stress: level 1 already goes over %1ms").arg(stress_ramp.GetTargetMs()));
+			quit_requested = true;
+		}
+	}
+
+	draw->Text2D(10, height - 30, FrameFormat("stress level %.2f, %d shots, %d FX", level, int(game->shoots.size()), int(game->fxs.size())), 20.f, Color::White, "@data:impact.ttf");
+	return false;
+}
+
+//
+bool DetectGameStart();
 
 bool HowToPlayWaitFade() { 
-	g_plus.get().Image2D(0, 0, 1, "@data:default_screen.jpg");
-	g_plus.get().Image2D(0, 0, 1, "@data:how_to_play_02.png");
+	draw->Image2D(0, 0, 1, "@data:default_screen.jpg");
+	draw->Image2D(0, 0, 1, "@data:how_to_play_02.png");
 
 	if (!IsFading()) {
-		next_game_state = how_to_play_branch_to;
+		game->next_game_state = game->how_to_play_branch_to;
 		return true;
 	}
 	return false;
 }
 
 bool HowToPlayScreen() { 
-	g_plus.get().Image2D(0, 0, 1, "@data:default_screen.jpg");
+	draw->Image2D(0, 0, 1, "@data:default_screen.jpg");
+
+	auto now = game->frame_timers.GetNow();
+	auto how_to_play_time = now - game->how_to_play_start;
 
 	if (how_to_play_time > time_from_sec(8)) {
-		g_plus.get().Image2D(0, 0, 1, "@data:how_to_play_02.png");
+		draw->Image2D(0, 0, 1, "@data:how_to_play_02.png");
 		if (AnyButtonPressed() != -1)
 			how_to_play_time = time_from_sec(16);
 	} else {
-		g_plus.get().Image2D(0, 0, 1, "@data:how_to_play_01.png");
+		draw->Image2D(0, 0, 1, "@data:how_to_play_01.png");
 		if (AnyButtonPressed() != -1)
 			how_to_play_time = time_from_sec(8);
 	}
+	game->how_to_play_start = now - how_to_play_time;
 
 	if (how_to_play_time > time_from_sec(16)) {
 		SetFade(Color(0, 0, 0, 0));
 		FadeTo(Color::Black, time_from_sec_f(0.5f));
-		next_game_state = &HowToPlayWaitFade;
+		game->next_game_state = &HowToPlayWaitFade;
 		return true;
 	}
-
-	how_to_play_time += GetLastFrameDuration();
 	return false;
 }
 
 bool HowToPlay() {
-	how_to_play_time = 0;
+	game->how_to_play_start = game->frame_timers.GetNow();
 	SetFade(Color::White);
 	FadeTo(Color(1, 1, 1, 0));
-	next_game_state = &HowToPlayScreen;
+	game->next_game_state = &HowToPlayScreen;
 	return true;
 }
 
 //
-time_ns join_delay;
-
 void DrawPlayerJoinScreen() { 
-	g_plus.get().Image2D(0, 0, 1, "@data:default_screen.jpg");
-	g_plus.get().Image2D(0, 0, 1, "@data:join_overlay.png");
+	draw->Image2D(0, 0, 1, "@data:default_screen.jpg");
+	draw->Image2D(0, 0, 1, "@data:join_overlay.png");
 
 	FullscreenQuad(Color(0, 0, 0, 0.75f));
 
-	DrawText2DCentered(width / 4, height / 4 - 40.f, players[0].ai ? "CPU" : "P1", 128.f, players_color[0], "@data:impact.ttf");
-	DrawText2DCentered(width / 4, height / 4 * 3 - 40.f, players[1].ai ? "CPU" : "P2", 128.f, players_color[1], "@data:impact.ttf");
-	DrawText2DCentered(width / 4 * 3, height / 4 - 40.f, players[2].ai ? "CPU" : "P3", 128.f, players_color[2], "@data:impact.ttf");
-	DrawText2DCentered(width / 4 * 3, height / 4 * 3 - 40.f, players[3].ai ? "CPU" : "P4", 128.f, players_color[3], "@data:impact.ttf");
+	DrawText2DCentered(width / 4, height / 4 - 40.f, game->players[0].ai ? "CPU" : "P1", 128.f, players_color[0], "@data:impact.ttf");
+	DrawText2DCentered(width / 4, height / 4 * 3 - 40.f, game->players[1].ai ? "CPU" : "P2", 128.f, players_color[1], "@data:impact.ttf");
+	DrawText2DCentered(width / 4 * 3, height / 4 - 40.f, game->players[2].ai ? "CPU" : "P3", 128.f, players_color[2], "@data:impact.ttf");
+	DrawText2DCentered(width / 4 * 3, height / 4 * 3 - 40.f, game->players[3].ai ? "CPU" : "P4", 128.f, players_color[3], "@data:impact.ttf");
 
-	DrawText2DCentered(width / 4, height / 4 - 120.f, players[0].ai ? "Join now!" : "Get ready!", 48.f, players_color[0], "@data:impact.ttf");
-	DrawText2DCentered(width / 4, height / 4 * 3 - 120.f, players[1].ai ? "Join now!" : "Get ready!", 48.f, players_color[1], "@data:impact.ttf");
-	DrawText2DCentered(width / 4 * 3, height / 4 - 120.f, players[2].ai ? "Join now!" : "Get ready!", 48.f, players_color[2], "@data:impact.ttf");
-	DrawText2DCentered(width / 4 * 3, height / 4 * 3 - 120.f, players[3].ai ? "Join now!" : "Get ready!", 48.f, players_color[3], "@data:impact.ttf");
+	DrawText2DCentered(width / 4, height / 4 - 120.f, game->players[0].ai ? "Join now!" : "Get ready!", 48.f, players_color[0], "@data:impact.ttf");
+	DrawText2DCentered(width / 4, height / 4 * 3 - 120.f, game->players[1].ai ? "Join now!" : "Get ready!", 48.f, players_color[1], "@data:impact.ttf");
+	DrawText2DCentered(width / 4 * 3, height / 4 - 120.f, game->players[2].ai ? "Join now!" : "Get ready!", 48.f, players_color[2], "@data:impact.ttf");
+	DrawText2DCentered(width / 4 * 3, height / 4 * 3 - 120.f, game->players[3].ai ? "Join now!" : "Get ready!", 48.f, players_color[3], "@data:impact.ttf");
 
-	DrawText2DCentered(width / 2, height / 2 - 160.f, format("%1").arg(time_to_sec(join_delay)).c_str(), 190.f, Color::White, "@data:komikax.ttf");
+	DrawText2DCentered(width / 2, height / 2 - 160.f, FrameFormat("%d", int(time_to_sec(game->join_delay))), 190.f, Color::White, "@data:komikax.ttf");
 }
 
 bool WaitJoinFadeOut() { 
 	DrawPlayerJoinScreen();
 
 	if (!IsFading()) {
-		next_game_state = &HowToPlay;
+		game->next_game_state = &HowToPlay;
 		return true;
 	}
 
@@ -960,8 +1286,8 @@ bool WaitJoinFadeOut() {
 }
 
 int GetPlayerIdxUsingGamepad(int pad_idx) {
-	for (size_t i = 0; i < players.size(); i++) {
-		if (players[i].gamepad == pad_idx){
+	for (size_t i = 0; i < game->players.size(); i++) {
+		if (game->players[i].gamepad == pad_idx){
 			return i;
 		}
 	}
@@ -971,11 +1297,13 @@ int GetPlayerIdxUsingGamepad(int pad_idx) {
 void RegisterNewHumanPlayer(int pad_idx) {
 	int next_player_idx = GetNextPlayer();
 	if (next_player_idx != -1) {
-		g_plus.get().GetMixer()->Start(*beep);
+		PlaySFX(SfxBeep);
 
-		Player *player = &players[next_player_idx];
+		Player *player = &game->players[next_player_idx];
 		player->ai = false;
 		player->gamepad = pad_idx;
+
+		TelemetryLog(TelemetryPlayerJoin, next_player_idx, pad_idx);
 	}
 };
 
@@ -990,34 +1318,34 @@ bool PlayerJoinScreen() {
 			RegisterNewHumanPlayer(pad_idx);// player controlled
 		}
 		else {
-			join_delay -= time_from_sec(1);
+			game->frame_timers.Reschedule(game->join_timer, game->frame_timers.GetRemaining(game->join_timer) - time_from_sec(1));
 		}
 	}
 
 	bool join_done = true;
-	for (auto &player : players)
+	for (auto &player : game->players)
 		if (player.ai)
 			join_done = false;
 
-	join_delay -= GetLastFrameDuration();
-	if (join_delay < 0) {
-		join_delay = 0;
+	game->join_delay = game->frame_timers.GetRemaining(game->join_timer);
+	if (!game->frame_timers.IsPending(game->join_timer))
 		join_done = true;
-	}
 
 	if (join_done) {
 		SetFade(Color(0, 0, 0, 0));
 		FadeTo(Color::Black, time_from_sec(1));
-		next_game_state = &WaitJoinFadeOut;
+		game->next_game_state = &WaitJoinFadeOut;
 		return true;
 	}
 	return false;
 }
 
 void InitJoinScreen() {
-	how_to_play_branch_to = &GameInit;
-	how_to_play_can_start_game = false;
-	join_delay = time_from_sec(10);
+	game->how_to_play_branch_to = &GameInit;
+	game->how_to_play_can_start_game = false;
+	game->join_delay = time_from_sec(10);
+	game->frame_timers.Cancel(game->join_timer);
+	game->join_timer = game->frame_timers.Schedule(game->join_delay);
 }
 
 //
@@ -1026,13 +1354,13 @@ bool DetectGameStart() {
 
 	if (pad_idx != -1) {
 
-		for (auto &player : players)
+		for (auto &player : game->players)
 			player.ai = true; // CPU controlled
 
 		RegisterNewHumanPlayer(pad_idx); // player controlled
 
 		InitJoinScreen();
-		next_game_state = &PlayerJoinScreen;
+		game->next_game_state = &PlayerJoinScreen;
 
 		SetFade(Color::White);
 		FadeTo(Color(1, 1, 1, 0));
@@ -1043,34 +1371,26 @@ bool DetectGameStart() {
 }
 
 //
-int intro_seq;
-time_ns intro_seq_delay;
-
-time_ns intro_t;
-
 Vector2 Lerp(const Vector2 &a, const Vector2 &b, float t) { return (b - a) * t + a; }
 
 void DrawTitle() {
-	g_plus.get().Image2D(0, 0, 1, "@data:intro_bg.jpg");
+	draw->Image2D(0, 0, 1, "@data:intro_bg.jpg");
 
+	auto intro_t = game->frame_timers.GetNow() - game->intro_start;
 	auto t_earth = Clamp<float>(time_to_sec_f(intro_t) / 18.f);
 	auto earth_pos = Lerp(Vector2(0, -400), Vector2(0, 0), t_earth);
 
-	g_plus.get().Image2D(earth_pos.x, earth_pos.y, 1, "@data:intro_earth.png");
-	if (intro_seq >= 4)
-		g_plus.get().Image2D(width - 455, height - 520, 1, "@data:intro_alien.png");
+	draw->Image2D(earth_pos.x, earth_pos.y, 1, "@data:intro_earth.png");
+	if (game->intro_seq >= 4)
+		draw->Image2D(width - 455, height - 520, 1, "@data:intro_alien.png");
 
-	if (intro_seq > 0)
-		g_plus.get().Image2D(0, height / 2.f - 140.f, 1.f, format("@data:intro_text0%1.png").arg(Clamp(intro_seq, 1, 4)));
+	if (game->intro_seq > 0)
+		draw->Image2D(0, height / 2.f - 140.f, 1.f, FrameFormat("@data:intro_text0%d.png", Clamp(game->intro_seq, 1, 4)));
 
 	if ((intro_t % time_from_sec_f(1)) > time_from_sec_f(0.5f))
-		g_plus.get().Image2D(0, 80, 1, "@data:press_any_button_text.png");
-
-	intro_t += GetLastFrameDuration();
+		draw->Image2D(0, 80, 1, "@data:press_any_button_text.png");
 }
 
-bool title_loop_attract{true};
-
 bool TitleWaitFadeOut() {
 	if (DetectGameStart())
 		return true;
@@ -1078,9 +1398,9 @@ bool TitleWaitFadeOut() {
 	DrawTitle();
 
 	if (!IsFading()) {
-		next_game_state = title_loop_attract ? &AttractMode : &HowToPlay;
-		title_loop_attract = !title_loop_attract;
-		how_to_play_can_start_game = true;
+		game->next_game_state = game->title_loop_attract ? &AttractMode : &HowToPlay;
+		game->title_loop_attract = !game->title_loop_attract;
+		game->how_to_play_can_start_game = true;
 		return true;
 	}
 	return false;
@@ -1092,22 +1412,20 @@ bool IntroAndTitleScreen() {
 
 	DrawTitle();
 
-	intro_seq_delay -= GetLastFrameDuration();
-
-	if (intro_seq_delay < 0) {
-		++intro_seq;
+	if (!game->frame_timers.IsPending(game->intro_seq_timer)) {
+		++game->intro_seq;
 
-		if (intro_seq == 5) {
+		if (game->intro_seq == 5) {
 			SetFade(Color(0, 0, 0, 0));
 			FadeTo(Color::Black, time_from_sec(2));
-			next_game_state = &TitleWaitFadeOut;
+			game->next_game_state = &TitleWaitFadeOut;
 			return true;
-		} else if (intro_seq == 4) {
-			intro_seq_delay = time_from_sec(6);
+		} else if (game->intro_seq == 4) {
+			game->intro_seq_timer = game->frame_timers.Schedule(time_from_sec(6));
 			SetFade(Color::White);
 			FadeTo(Color(1, 1, 1, 0), time_from_sec(1));
 		} else {
-			intro_seq_delay = time_from_sec(3);
+			game->intro_seq_timer = game->frame_timers.Schedule(time_from_sec(3));
 		}
 	}
 	return false;
@@ -1118,69 +1436,1567 @@ bool Title() {
 	SetFade(Color(0, 0, 0, 1));
 	FadeTo(Color(0, 0, 0, 0), time_from_sec(6));
 
-	intro_t = 0;
-	intro_seq = 0;
-	intro_seq_delay = time_from_sec(6);
+	game->intro_start = game->frame_timers.GetNow();
+	game->intro_seq = 0;
+	game->frame_timers.Cancel(game->intro_seq_timer);
+	game->intro_seq_timer = game->frame_timers.Schedule(time_from_sec(6));
 
-	next_game_state = &IntroAndTitleScreen;
-	how_to_play_branch_to = &Title;
-	how_to_play_can_start_game = false;
+	game->next_game_state = &IntroAndTitleScreen;
+	game->how_to_play_branch_to = &Title;
+	game->how_to_play_can_start_game = false;
 	return true;
 }
 
-bool SetupGamepads() {
-	InitGamepadDevice(gamepads[0], g_input_system.get().GetDevice("xinput.port0"), Gamepad);
-	InitGamepadDevice(gamepads[1], g_input_system.get().GetDevice("xinput.port1"), Gamepad);
-	InitGamepadDevice(gamepads[2], g_input_system.get().GetDevice("xinput.port2"), Gamepad);
-	InitGamepadDevice(gamepads[3], g_input_system.get().GetDevice("xinput.port3"), Gamepad);
+// Lua bindings: the "tako" module exposes the native simulation so that scripts
+// can drive game flow and presentation while ticks run in C++.
+static int lua_GameInit(lua_State *L) {
+	GameInit();
+	return 0;
+}
 
-	InitKeyboardDevice(gamepads[4], g_input_system.get().GetDevice("keyboard"), Keyboard, 0);
-	InitKeyboardDevice(gamepads[5], g_input_system.get().GetDevice("keyboard"), Keyboard, 1);
-	InitKeyboardDevice(gamepads[6], g_input_system.get().GetDevice("keyboard"), Keyboard, 2);
-	InitKeyboardDevice(gamepads[7], g_input_system.get().GetDevice("keyboard"), Keyboard, 3);
-	return true;
+static int lua_Tick(lua_State *L) { // Tick(dt_sec, [count])
+	auto dt = time_from_sec_f(float(luaL_checknumber(L, 1)));
+	auto count = luaL_optinteger(L, 2, 1);
+	for (lua_Integer i = 0; i < count; ++i)
+		GameTick(dt);
+	return 0;
 }
 
-//
-int main(int narg, const char **args) {
-	Init();
-	LoadPlugins();
+static int lua_GetLastFrameDuration(lua_State *L) {
+	lua_pushnumber(L, time_to_sec_f(GetFrameDuration()));
+	return 1;
+}
 
-	if (!g_plus.get().RenderInit(720, 1280, 4) || !g_plus.get().AudioInit())
-		return 1;
+static int lua_Draw(lua_State *L) {
+	DrawBG();
+	GameDraw();
+	return 0;
+}
 
-	g_plus.get().SetWindowTitle("Invasion of the Tako Nation - Harfang 3D");
+static int CheckPlayerIdx(lua_State *L, int arg) {
+	auto idx = luaL_checkinteger(L, arg);
+	luaL_argcheck(L, idx >= 0 && idx < lua_Integer(game->players.size()), arg, "invalid player index");
+	return int(idx);
+}
+
+static int lua_SetPlayerAI(lua_State *L) { // SetPlayerAI(idx, ai)
+	game->players[CheckPlayerIdx(L, 1)].ai = lua_toboolean(L, 2) != 0;
+	return 0;
+}
+
+static int lua_SetPlayerInput(lua_State *L) { // SetPlayerInput(idx, angle, fire)
+	int idx = CheckPlayerIdx(L, 1);
+	auto &player = game->players[idx];
+
+	player.angle = float(luaL_checknumber(L, 2));
+
+	if (lua_toboolean(L, 3)) {
+		auto shots = GetPlayerShoots(idx);
+		if (shots.size() > 0)
+			PlayerFireShot(idx, shots[0]);
+	}
+	return 0;
+}
+
+static int lua_GetPlayer(lua_State *L) { // x, y, angle, shot count
+	int idx = CheckPlayerIdx(L, 1);
+	auto &player = game->players[idx];
+
+	int count = 0;
+	for (auto &shoot : game->shoots)
+		if (shoot.held && shoot.player_seq[shoot.player_seq_idx] == idx)
+			++count;
+
+	lua_pushnumber(L, player.pos.x);
+	lua_pushnumber(L, player.pos.y);
+	lua_pushnumber(L, player.angle);
+	lua_pushinteger(L, count);
+	return 4;
+}
+
+static int lua_GetShootCount(lua_State *L) {
+	lua_pushinteger(L, game->shoots.size());
+	return 1;
+}
+
+static int lua_GetShoot(lua_State *L) { // x, y, held, sequence index
+	auto idx = luaL_checkinteger(L, 1);
+	luaL_argcheck(L, idx >= 0 && idx < lua_Integer(game->shoots.size()), 1, "invalid shoot index");
+	auto &shoot = game->shoots[idx];
+
+	lua_pushnumber(L, shoot.pos.x);
+	lua_pushnumber(L, shoot.pos.y);
+	lua_pushboolean(L, shoot.held);
+	lua_pushinteger(L, shoot.player_seq_idx);
+	return 4;
+}
+
+static int lua_GetHealth(lua_State *L) { // human, alien
+	lua_pushinteger(L, game->human_health);
+	lua_pushinteger(L, game->alien_health);
+	return 2;
+}
+
+static int lua_AnyButtonPressed(lua_State *L) {
+	lua_pushinteger(L, AnyButtonPressed());
+	return 1;
+}
+
+static int lua_Image2D(lua_State *L) { // Image2D(x, y, path)
+	draw->Image2D(float(luaL_checknumber(L, 1)), float(luaL_checknumber(L, 2)), 1, luaL_checkstring(L, 3));
+	return 0;
+}
+
+static int lua_Text2D(lua_State *L) { // Text2D(x, y, text, size)
+	DrawText2DCentered(float(luaL_checknumber(L, 1)), float(luaL_checknumber(L, 2)), luaL_checkstring(L, 3), float(luaL_optnumber(L, 4, 32)), Color::White, "@data:komikax.ttf");
+	return 0;
+}
+
+static const luaL_Reg tako_lib[] = {
+	{"GameInit", lua_GameInit},
+	{"Tick", lua_Tick},
+	{"GetLastFrameDuration", lua_GetLastFrameDuration},
+	{"Draw", lua_Draw},
+	{"SetPlayerAI", lua_SetPlayerAI},
+	{"SetPlayerInput", lua_SetPlayerInput},
+	{"GetPlayer", lua_GetPlayer},
+	{"GetShootCount", lua_GetShootCount},
+	{"GetShoot", lua_GetShoot},
+	{"GetHealth", lua_GetHealth},
+	{"AnyButtonPressed", lua_AnyButtonPressed},
+	{"Image2D", lua_Image2D},
+	{"Text2D", lua_Text2D},
+	{nullptr, nullptr}};
+
+extern "C" int luaopen_tako(lua_State *L) {
+	luaL_newlib(L, tako_lib);
+	return 1;
+}
+
+// run the script, entry names a global function it must define (may be null)
+lua_State *OpenScript(const char *path, const char *entry = nullptr) {
+	auto L = luaL_newstate();
+	luaL_openlibs(L);
+	luaL_requiref(L, "tako", luaopen_tako, 1);
+	lua_pop(L, 1);
+
+	if (luaL_dofile(L, path) != LUA_OK) {
+		error(format("Failed to run script %1: %2").arg(path).arg(lua_tostring(L, -1)));
+		lua_close(L);
+		return nullptr;
+	}
+
+	if (entry) {
+		lua_getglobal(L, entry);
+		bool defined = lua_isfunction(L, -1);
+		lua_pop(L, 1);
+
+		if (!defined) {
+			error(format("Script %1 does not define %2()").arg(path).arg(entry));
+			lua_close(L);
+			return nullptr;
+		}
+	}
+	return L;
+}
+
+lua_State *script;
+
+bool ScriptFrame() { // the script drives the game through its global Frame()
+	lua_getglobal(script, "Frame");
+	if (lua_pcall(script, 0, 0, 0) != LUA_OK) {
+		error(format("Script error: %1").arg(lua_tostring(script, -1)));
+		lua_pop(script, 1);
+		quit_requested = true; // the error would repeat every frame
+	}
+	return false;
+}
 
-	if (!SetupGamepads())
+// run the simulation from a benchmark script, without render or audio
+int RunScriptBenchmark(const char *path) {
+	headless = true;
+	for (auto &player : game->players)
+		player.ai = true;
+
+	auto L = OpenScript(path);
+	if (!L)
 		return 1;
+	lua_close(L);
+	return 0;
+}
 
+// step a batch of training environments with scripted drones aiming at their next target
+int RunEnvBenchmark(int env_count) {
+	BatchEnv env(env_count, 1);
+
+	std::vector<float> angles(env_count * batch_env_drone_count), obs(env_count * batch_env_obs_size), rewards(env_count);
+	std::vector<uint8_t> fires(env_count * batch_env_drone_count), dones(env_count);
+
+	env.Reset(obs.data());
+
+	constexpr int step_count = 60 * 60;
+	int episode_count = 0;
+
+	auto t = std::chrono::steady_clock::now();
+	for (int i = 0; i < step_count; ++i) {
+		BatchEnv::ScriptedActions(env_count, obs.data(), angles.data(), fires.data());
+		env.Step(angles.data(), fires.data(), obs.data(), rewards.data(), dones.data());
+
+		for (auto done : dones)
+			episode_count += done;
+	}
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+
+	log(format("Batch env: %1 envs, %2 steps in %3 ms, %4 env-steps/sec, %5 episodes").arg(env_count).arg(step_count).arg(int(elapsed * 1000.0)).arg(int64_t(env_count * step_count / elapsed)).arg(episode_count));
+	return 0;
+}
+
+//
+// software mixing for the headless runs: sounds are decoded through the engine audio IO
+constexpr int soft_mixer_rate = 44100;
+
+void MountData() {
 #if _DEBUG
 	g_plus.get().MountAs("d:/gs-users/ggj2018/data", "@data:");
 #else
 	g_plus.get().MountAs("./data", "@data:");
 #endif
-	g_plus.get().SetBlend2D(BlendAlpha);
+}
+
+struct DecodedSound {
+	AudioFormat format;
+	std::vector<int16_t> samples; // interleaved
+};
+
+bool DecodeSamples(const char *path, DecodedSound &sound) {
+	auto data = g_audio_io.get().Open(path);
+	if (!data) {
+		error(format("Failed to open %1").arg(path));
+		return false;
+	}
+
+	auto fmt = data->GetFormat();
+	if (fmt.resolution != 16) {
+		error(format("%1: %2 bit samples, only 16 bit is supported").arg(path).arg(fmt.resolution));
+		return false;
+	}
+
+	sound.format = fmt;
+	sound.samples.clear();
+
+	Data chunk;
+	while (data->GetNextChunk(chunk)) {
+		auto begin = static_cast<const int16_t *>(chunk.GetData());
+		sound.samples.insert(sound.samples.end(), begin, begin + chunk.GetSize() / sizeof(int16_t));
+		chunk.Reset();
+	}
+	return true;
+}
+
+bool DecodeSound(const char *path, PcmSound &pcm) {
+	DecodedSound sound;
+	if (!DecodeSamples(path, sound))
+		return false;
+
+	auto &fmt = sound.format;
+	PcmFromInt16(pcm, sound.samples.data(), sound.samples.size() / fmt.channels, fmt.channels, fmt.frequency, soft_mixer_rate);
+	return true;
+}
 
-	if (!LoadSoundFXs())
+bool DecodeSoundFXs() {
+	for (int i = 0; i < SfxCount; ++i)
+		if (!DecodeSound(sfx_paths[i], sfx_pcm[i]))
+			return false;
+	return true;
+}
+
+struct MusicDecoder {
+	std::shared_ptr<AudioData> data;
+	Data chunk;
+};
+
+size_t DecodeMusicChunk(const int16_t *&samples, void *user) { // music stream thread, loops like Mixer::RepeatState
+	auto &decoder = *static_cast<MusicDecoder *>(user);
+	auto frame_bytes = sizeof(int16_t) * decoder.data->GetFormat().channels;
+
+	for (int attempt = 0; attempt < 2; ++attempt) {
+		decoder.chunk.Reset();
+		if (decoder.data->GetNextChunk(decoder.chunk)) {
+			samples = static_cast<const int16_t *>(decoder.chunk.GetData());
+			return decoder.chunk.GetSize() / frame_bytes;
+		}
+		decoder.data->Seek(0);
+	}
+	return 0;
+}
+
+// run an AI match without render nor audio device, mixing its sounds and the music into a WAV file or nowhere
+int RunAudioOut(const char *path, int seconds) {
+	headless = true;
+	LoadPlugins();
+	MountData();
+
+	if (!DecodeSoundFXs())
 		return 1;
 
-	g_plus.get().GetMixer()->Stream("@data:zik.ogg", Mixer::RepeatState);
+	MusicDecoder music_decoder;
+	music_decoder.data = g_audio_io.get().Open("@data:zik.ogg");
+	if (!music_decoder.data) {
+		error("Failed to open @data:zik.ogg");
+		return 1;
+	}
 
-	game_state = &Title;
+	auto music_fmt = music_decoder.data->GetFormat();
+	MusicStream music(&DecodeMusicChunk, &music_decoder, music_fmt.channels, music_fmt.frequency, soft_mixer_rate);
+	music.Start();
 
-	while (!g_plus.get().IsAppEnded()) {
-		g_plus.get().Clear(Color::Black);
+	WavWriter wav;
+	if (strcmp(path, "null") && !wav.Open(path, soft_mixer_rate)) {
+		error(format("Failed to open %1").arg(path));
+		return 1;
+	}
+
+	SoftMixer mixer(soft_mixer_rate);
+	mixer.SetMusic(&music);
+	soft_mixer = &mixer;
+
+	for (auto &player : game->players)
+		player.ai = true;
+	GameInit();
+
+	std::vector<int16_t> out;
+	int64_t frames_due = 0; // in rate * ns units, ticks do not hold a whole number of frames
+	int64_t mixed = 0, mix_ns = 0;
+
+	auto tick_total = time_from_sec(seconds) / sim_step;
+	for (int64_t i = 0; i < tick_total; ++i) {
+		GameTick(sim_step);
+		if (game->human_health <= 0 || game->alien_health <= 0)
+			GameInit(); // next match
+
+		frames_due += int64_t(soft_mixer_rate) * sim_step;
+		auto frame_count = int(frames_due / time_from_sec(1));
+		frames_due -= frame_count * time_from_sec(1);
 
-		if (game_state())
-			game_state = next_game_state;
+		out.resize(size_t(frame_count) * soft_mixer_channels);
+		music.WaitForFrames(frame_count); // faster than real time, the decoder must keep up
+
+		auto t = std::chrono::steady_clock::now();
+		mixer.Mix(out.data(), frame_count);
+		mix_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t).count();
+
+		wav.Write(out.data(), frame_count);
+		mixed += frame_count;
+	}
+
+	wav.Close();
+	music.Stop();
+	soft_mixer = nullptr;
+
+	log(format("Audio out: %1s mixed in %2ms, %3 sound starts, %4 clipped samples, %5 music underruns").arg(int(mixed / soft_mixer_rate)).arg(int(mix_ns / 1000000))
+		.arg(int(mixer.GetStartCount())).arg(int(mixer.GetClipCount())).arg(int(music.GetUnderrunCount())));
+	return 0;
+}
+
+// mixing cost with voice_count looping voices, SSE2 kernel against the scalar one
+int RunMixerBenchmark(int voice_count) {
+	LoadPlugins();
+	MountData();
+
+	if (!DecodeSoundFXs())
+		return 1;
+
+	SoftMixer mixer(soft_mixer_rate, voice_count);
+	for (int i = 0; i < voice_count; ++i)
+		mixer.Start(sfx_pcm[i % SfxCount], 1.f / voice_count, true);
+
+	constexpr int block_frames = 512, block_count = 60 * soft_mixer_rate / block_frames; // a minute of audio
+	std::vector<int16_t> out(block_frames * soft_mixer_channels);
+
+	auto t = std::chrono::steady_clock::now();
+	for (int i = 0; i < block_count; ++i)
+		mixer.Mix(out.data(), block_frames);
+	auto mix_ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t).count());
+
+	// the voice kernels alone over the same sample count
+	std::vector<float> acc(block_frames * soft_mixer_channels), src(acc.size(), 0.5f);
+	auto kernel_ns = [&](void (*mix)(float *, const float *, int, float)) {
+		static volatile float sink; // keep the results alive
+		auto t = std::chrono::steady_clock::now();
+		for (int i = 0; i < block_count; ++i)
+			for (int v = 0; v < voice_count; ++v)
+				mix(acc.data(), src.data(), int(acc.size()), 0.5f);
+		sink = acc[0];
+		return double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t).count()) / (double(block_count) * voice_count);
+	};
+	auto simd_ns = kernel_ns(&MixSamples), scalar_ns = kernel_ns(&MixSamplesScalar);
+
+	log(format("Mixer: %1 voices, %2us per %3 frame block, %4ns per voice per block, %5x real time").arg(voice_count).arg(mix_ns / block_count / 1000.0).arg(block_frames)
+		.arg(mix_ns / block_count / voice_count).arg((double(block_count) * block_frames / soft_mixer_rate) / (mix_ns * 1e-9)));
+	log(format("Mixer: voice kernel %1ns per block, scalar %2ns").arg(simd_ns).arg(scalar_ns));
+	return 0;
+}
+
+// recording cost of count circles and count discs a frame, batched against one call per segment as they used to be
+int RunOverlayBenchmark(int count) {
+	constexpr int frame_count = 600, circle_seg = 24, disc_seg = 12;
+
+	DrawList list;
+	auto frame_us = [&](void (*circle)(DrawList &, float, float, float, int, const Color &), void (*disc)(DrawList &, float, float, float, int, const Color &)) {
+		auto t = std::chrono::steady_clock::now();
+		for (int f = 0; f < frame_count; ++f) {
+			list.Clear();
+			for (int i = 0; i < count; ++i) {
+				auto x = float(i % 32) * 22.f, y = float(i / 32 % 58) * 22.f;
+				circle(list, x, y, 20.f, circle_seg, Color::Red);
+				disc(list, x, y, 6.f, disc_seg, Color::Green);
+			}
+		}
+		return double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t).count()) / frame_count / 1000.0;
+	};
+
+	auto batched_us = frame_us([](DrawList &l, float x, float y, float r, int nseg, const Color &c) { l.Circle2D(x, y, r, nseg, c); },
+		[](DrawList &l, float x, float y, float r, int nseg, const Color &c) { l.Disc2D(x, y, r, nseg, c); });
+	auto vertex_count = list.GetPrimitiveVertexCount(), run_count = list.GetPrimitiveRunCount(), batched_call_count = list.GetCommandCount();
+
+	auto per_segment_us = frame_us(
+		[](DrawList &l, float x, float y, float r, int nseg, const Color &c) {
+			float step = Deg(360.f) / nseg, angle = 0.f, sx = x, sy = r + y, ex, ey;
+			for (int i = 0; i < nseg; ++i) {
+				angle += step;
+				DetSinCos(angle, ex, ey);
+				ex = ex * r + x;
+				ey = ey * r + y;
+				l.Line2D(sx, sy, ex, ey, c, c);
+				sx = ex;
+				sy = ey;
+			}
+		},
+		[](DrawList &l, float x, float y, float r, int nseg, const Color &c) {
+			float step = Deg(360.f) / nseg, angle = 0.f, sx = x, sy = r + y, ex, ey;
+			for (int i = 0; i < nseg; ++i) {
+				angle += step;
+				DetSinCos(angle, ex, ey);
+				ex = ex * r + x;
+				ey = ey * r + y;
+				l.Triangle2D(ex, ey, x, y, sx, sy, c, c, c);
+				sx = ex;
+				sy = ey;
+			}
+		});
+	auto call_count = list.GetCommandCount();
+
+	log(format("Overlay: %1 circles and %1 discs, batched %2us a frame in %3 primitive runs of %4 vertices, %5 calls").arg(count).arg(batched_us).arg(int(run_count))
+		.arg(int(vertex_count)).arg(int(batched_call_count)));
+	log(format("Overlay: one call per segment %1us a frame for %2 calls").arg(per_segment_us).arg(int(call_count)));
+	return 0;
+}
+
+// fail if the deterministic math or the batched simulation differ from the reference build
+int RunDeterminismCheck() {
+	constexpr uint32_t math_reference = 0x2f737611, sim_reference = 0xbf4bd38d;
+
+	auto math = DetMathChecksum(), sim = BatchEnv::Checksum(16, 60 * 60);
+	log(format("Determinism check: math %1, simulation %2").arg(FrameFormat("%08x", math)).arg(FrameFormat("%08x", sim)));
+
+	if (math != math_reference || sim != sim_reference) {
+		error(format("Determinism check failed, expected math %1, simulation %2").arg(FrameFormat("%08x", math_reference)).arg(FrameFormat("%08x", sim_reference)));
+		return 1;
+	}
+
+	// the table trig replaces libm for determinism, it must not cost more: time both over the same angles
+	constexpr int trig_count = 1 << 20;
+	auto trig_ns = [](float (*trig)(float a, float y)) {
+		static volatile float sink; // keep the results alive
+		float acc = 0.f;
+		auto t = std::chrono::steady_clock::now();
+		for (int i = 0; i < trig_count; ++i)
+			acc += trig(float(i - trig_count / 2) * 0.00731f, float(i % 97) - 48.f);
+		sink = acc;
+		return double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t).count()) / trig_count;
+	};
+
+	auto table_ns = trig_ns([](float a, float y) {
+		float s, c;
+		DetSinCos(a, s, c);
+		return s + DetAtan2(y, c);
+	});
+	auto libm_ns = trig_ns([](float a, float y) { return std::sin(a) + std::atan2(y, std::cos(a)); });
+
+	log(format("Determinism check: sin, cos and atan2 in %1ns with the tables, %2ns with libm").arg(FrameFormat("%.1f", table_ns)).arg(FrameFormat("%.1f", libm_ns)));
+	if (table_ns > libm_ns)
+		warn("Determinism check: the table trig is slower than libm on this build");
+
+	// the first shot must spawn on the same step in the game and in the training environment
+	int game_step = 0, env_step = 0;
+
+	headless = true;
+	GameInit();
+	while (game->shoots.empty() && game_step < 60 * 60) {
+		GameTick(sim_reference_step);
+		++game_step;
+	}
+
+	BatchEnv env(1, 1);
+	float angles[batch_env_drone_count] = {};
+	uint8_t fires[batch_env_drone_count] = {}, done;
+	float reward;
+	env.Reset(nullptr);
+	while (env.GetShotCount(0) == 0 && env_step < 60 * 60) {
+		env.Step(angles, fires, nullptr, &reward, &done);
+		++env_step;
+	}
+
+	log(format("Determinism check: first shot spawned on step %1 in the game, %2 in the environment").arg(game_step).arg(env_step));
+	if (game_step != env_step || game_step != StepsFromSec(first_shoot_delay)) {
+		error(format("Determinism check failed, expected the first shot on step %1").arg(StepsFromSec(first_shoot_delay)));
+		return 1;
+	}
+	return 0;
+}
+
+// run the dynamic resolution controller without renderer, on the synthetic traces or on a recorded
+// trace file (one frame time in milliseconds per line)
+int RunResolutionCheck(const char *trace_path) {
+	if (!trace_path) {
+		auto failure = ResolutionControllerCheck();
+		if (failure) {
+			error(format("Dynamic resolution check failed: %1").arg(failure));
+			return 1;
+		}
+		log("Dynamic resolution check passed");
+		return 0;
+	}
+
+	auto file = fopen(trace_path, "r");
+	if (!file) {
+		error(format("Failed to open frame time trace %1").arg(trace_path));
+		return 1;
+	}
+
+	ResolutionController ctrl;
+	std::array<int, ResolutionController::level_count> frames_per_level{};
+	int frame_count = 0, change_count = 0;
+
+	float ms;
+	while (fscanf(file, "%f", &ms) == 1) {
+		auto level = ctrl.GetLevelIndex();
+		if (ctrl.Update(ms) != level) {
+			log(format("Frame %1: level %2, recent frames %3ms").arg(frame_count).arg(ctrl.GetLevelIndex()).arg(int(ctrl.GetRecentMs())));
+			++change_count;
+		}
+		++frames_per_level[ctrl.GetLevelIndex()];
+		++frame_count;
+	}
+	fclose(file);
+
+	log(format("%1 frames, %2 level changes").arg(frame_count).arg(change_count));
+	for (int i = 0; i < ResolutionController::level_count; ++i) {
+		auto &level = ResolutionController::GetLevel(i);
+		log(format("    level %1 (scale %2, MSAA %3x): %4 frames").arg(i).arg(level.scale).arg(level.msaa).arg(frames_per_level[i]));
+	}
+	return 0;
+}
+
+bool SetupGamepads() {
+	InitGamepadDevice(gamepads[0], g_input_system.get().GetDevice("xinput.port0"), Gamepad);
+	InitGamepadDevice(gamepads[1], g_input_system.get().GetDevice("xinput.port1"), Gamepad);
+	InitGamepadDevice(gamepads[2], g_input_system.get().GetDevice("xinput.port2"), Gamepad);
+	InitGamepadDevice(gamepads[3], g_input_system.get().GetDevice("xinput.port3"), Gamepad);
+
+	InitKeyboardDevice(gamepads[4], g_input_system.get().GetDevice("keyboard"), Keyboard, 0);
+	InitKeyboardDevice(gamepads[5], g_input_system.get().GetDevice("keyboard"), Keyboard, 1);
+	InitKeyboardDevice(gamepads[6], g_input_system.get().GetDevice("keyboard"), Keyboard, 2);
+	InitKeyboardDevice(gamepads[7], g_input_system.get().GetDevice("keyboard"), Keyboard, 3);
+	return true;
+}
+
+// fail if a steady state simulation tick allocates
+void RecordInstances();
+
+int RunAllocTest() {
+	headless = true;
+	fixed_frame_duration = sim_step; // one tick per recorded frame
+
+	for (auto &player : game->players)
+		player.ai = true;
+
+	GameInit();
+	game->game_state = &GameLoop;
+
+	// whole frames: input, ticks, drawing into the draw list, fades
+	auto record = [](int frame_count) {
+		for (int i = 0; i < frame_count; ++i) {
+			game->human_health = game->alien_health = 100; // the match must outlive the test
+			RecordInstances();
+			g_frame_arena.Reset();
+		}
+	};
+
+	record(60 * 60); // warm up
+
+	AllocStats allocs;
+	alloc_stages.fill({});
+	SetAllocSiteCapture(true);
+	{
+		AllocScope scope(allocs);
+		record(60 * 600);
+	}
+	SetAllocSiteCapture(false);
+
+	if (allocs.count) {
+		error(format("Allocation test failed: %1 allocations (%2 bytes) in steady state").arg(allocs.count).arg(allocs.bytes));
+		for (int i = 0; i < AllocStageCount; ++i)
+			if (alloc_stages[i].count)
+				error(format("    %1: %2 (%3 bytes)").arg(alloc_stage_names[i]).arg(alloc_stages[i].count).arg(alloc_stages[i].bytes));
+		DumpAllocSites();
+		return 1;
+	}
+
+	log(format("Allocation test passed: %1 recorded frames, %2 draw commands in the last one").arg(60 * 600).arg(int(draw->GetCommandCount())));
+	return 0;
+}
+
+// stable game state ids for the telemetry log, append new states at the end
+static const GameState game_states[] = {&Title, &IntroAndTitleScreen, &TitleWaitFadeOut, &AttractMode, &HowToPlay, &HowToPlayScreen, &HowToPlayWaitFade,
+	&PlayerJoinScreen, &WaitJoinFadeOut, &GameInit, &GameLoop, &GameOver, &GameOverFade, &ScriptFrame, &StressInit, &StressLoop};
+static const char *game_state_names[] = {"Title", "IntroAndTitleScreen", "TitleWaitFadeOut", "AttractMode", "HowToPlay", "HowToPlayScreen", "HowToPlayWaitFade",
+	"PlayerJoinScreen", "WaitJoinFadeOut", "GameInit", "GameLoop", "GameOver", "GameOverFade", "ScriptFrame", "StressInit", "StressLoop"};
+
+int GetGameStateId(GameState state) {
+	for (int i = 0; i < int(sizeof(game_states) / sizeof(game_states[0])); ++i)
+		if (game_states[i] == state)
+			return i;
+	return -1;
+}
+
+const char *GetGameStateName(int id) { return id >= 0 ? game_state_names[id] : "Unknown"; }
+
+//
+MetricsSample metrics_sample{}; // filled on the thread recording frames
+time_ns metrics_second_start{0};
+uint64_t metrics_second_ticks{0};
+
+void PublishMetrics(const AllocStats &frame_allocs) {
+	auto &m = metrics_sample;
+	auto clock = g_plus.get().GetClock();
+
+	m.frame_ms[m.frame_count % metrics_frame_window] = time_to_ms_f(GetLastFrameDuration());
+	++m.frame_count;
+
+	m.tick_count = tick_count;
+	if (clock - metrics_second_start >= time_from_sec(1)) {
+		m.ticks_per_sec = float(double(tick_count - metrics_second_ticks) / time_to_sec_f(clock - metrics_second_start));
+		metrics_second_start = clock;
+		metrics_second_ticks = tick_count;
+	}
+
+	m.shoot_count = m.fx_count = 0;
+	for (auto &instance : instances) {
+		m.shoot_count += uint32_t(instance.shoots.size());
+		m.fx_count += uint32_t(instance.fxs.size());
+	}
+	m.frame_allocs = uint32_t(frame_allocs.count);
+	m.frame_alloc_bytes = uint32_t(frame_allocs.bytes);
+	m.mixer_starts = mixer_start_count;
+	m.telemetry_dropped = TelemetryGetDropCount();
+	m.instance_count = std::min(int(instances.size()), metrics_max_instances);
+	for (int i = 0; i < m.instance_count; ++i) {
+		m.game_state[i] = GetGameStateId(instances[i].game_state);
+		m.game_state_name[i] = GetGameStateName(m.game_state[i]);
+	}
+	m.uptime_sec = double(clock) * 1e-9;
+
+	MetricsPublish(m);
+}
+
+//
+// texture residency: full screen images are grouped by the game states using them
+enum TextureGroup { TexturesTitle, TexturesMenus, TexturesGameplay, TexturesGameOver };
+
+// synchronous on the main thread, the engine loads textures there only: a prefetch costs a full screen image load
+// in the frame it lands in, TextureBudget::Update spreads them one per frame
+std::shared_ptr<void> LoadBudgetTexture(const char *path, size_t &bytes) {
+	auto texture = g_plus.get().GetRenderSystem()->LoadTexture(path);
+	if (texture)
+		bytes = size_t(texture->GetWidth()) * texture->GetHeight() * 4; // RGBA8, 2D textures have no mips
+	return texture;
+}
+
+void PurgeTextureCache() { g_plus.get().GetRenderSystem()->PurgeCache(); }
+
+TextureBudget texture_budget(&LoadBudgetTexture, &PurgeTextureCache);
+std::array<std::atomic<GameState>, max_instances> texture_hints{}; // per instance, set when recording, consumed when submitting
+std::array<GameState, max_instances> texture_states{}; // submit side, the last hint of each instance
+
+void InitTextureGroups() {
+	static const char *title[] = {"@data:intro_bg.jpg", "@data:intro_earth.png", "@data:intro_alien.png", "@data:intro_text01.png", "@data:intro_text02.png",
+		"@data:intro_text03.png", "@data:intro_text04.png", "@data:press_any_button_text.png"};
+	static const char *menus[] = {"@data:default_screen.jpg", "@data:how_to_play_01.png", "@data:how_to_play_02.png", "@data:join_overlay.png"};
+	static const char *gameplay[] = {"@data:space_bg.jpg", "@data:tentacles.png", "@data:drone.png", "@data:drone_buffer.png", "@data:drone_arrow.png",
+		"@data:drone_shoot.png", "@data:fx_donut.png", "@data:alien_blood.png", "@data:human_blood.png", "@data:alien_avatar.png", "@data:human_avatar.png"};
+	static const char *game_over[] = {"@data:default_screen.jpg", "@data:victory_text.png", "@data:game_over_text.png"};
+
+	texture_budget.AddToGroup(TexturesTitle, title, int(sizeof(title) / sizeof(title[0])));
+	texture_budget.AddToGroup(TexturesMenus, menus, int(sizeof(menus) / sizeof(menus[0])));
+	texture_budget.AddToGroup(TexturesGameplay, gameplay, int(sizeof(gameplay) / sizeof(gameplay[0])));
+	texture_budget.AddToGroup(TexturesGameOver, game_over, int(sizeof(game_over) / sizeof(game_over[0])));
+}
+
+// the textures a state draws and those of the states likely to follow it
+void GetStateTextureGroups(GameState state, int &current, int &next, int &after) {
+	current = next = after = -1;
+
+	if (state == &Title || state == &IntroAndTitleScreen || state == &TitleWaitFadeOut) {
+		current = TexturesTitle; // ends in the attract mode or the how to play screen
+		next = TexturesGameplay;
+		after = TexturesMenus;
+	} else if (state == &AttractMode || state == &GameInit || state == &GameLoop || state == &StressInit || state == &StressLoop) {
+		current = TexturesGameplay;
+		next = TexturesGameOver;
+		after = TexturesTitle; // the attract mode returns to the title
+	} else if (state == &GameOver || state == &GameOverFade) {
+		current = TexturesGameOver;
+		next = TexturesTitle;
+	} else if (state == &HowToPlay || state == &HowToPlayScreen || state == &HowToPlayWaitFade || state == &PlayerJoinScreen || state == &WaitJoinFadeOut) {
+		current = TexturesMenus;
+		next = TexturesGameplay;
+	}
+}
+
+void UpdateTextureBudget(const DrawList &list) {
+	bool changed = false;
+	for (size_t i = 0; i < instances.size(); ++i)
+		if (auto state = texture_hints[i].exchange(nullptr)) {
+			texture_states[i] = state;
+			changed = true;
+		}
+
+	if (changed) { // the groups of all instances on screen stay in use
+		uint32_t current_groups = 0;
+		for (size_t i = 0; i < instances.size(); ++i) {
+			int current, next, after;
+			GetStateTextureGroups(texture_states[i], current, next, after);
+
+			if (current != -1)
+				current_groups |= 1u << current;
+			for (auto group : {current, next, after})
+				if (group != -1)
+					texture_budget.Prefetch(group);
+		}
+		texture_budget.SetCurrentGroups(current_groups);
+
+		log(format("Textures: %1 resident, %2 KB (budget %3 KB), %4 evictions").arg(texture_budget.GetResidentCount()).arg(int(texture_budget.GetResidentBytes() / 1024)).arg(int(texture_budget.GetBudget() / 1024)).arg(int(texture_budget.GetEvictionCount())));
+	}
+
+	list.ForEachImage([](const char *path, void *) { texture_budget.Touch(path); }, nullptr);
+
+	bool was_over_budget = texture_budget.IsOverBudget();
+	texture_budget.Update();
+	if (texture_budget.IsOverBudget() && !was_over_budget)
+		warn(format("Textures: a single frame needs %1 KB, over the %2 KB budget").arg(int(texture_budget.GetResidentBytes() / 1024)).arg(int(texture_budget.GetBudget() / 1024)));
+}
+
+//
+// frame pacing: gameplay runs at -frame-rate (vsync only by default), static screens drop to -idle-rate
+FramePacer frame_pacer;
+time_ns game_frame_interval{0}, idle_frame_interval{time_from_sec(1) / 20};
+std::atomic<time_ns> frame_interval_hint{0}; // set when recording, applied by the main loop
+
+time_ns GetStateFrameInterval(GameState state) {
+	bool is_static = state == &IntroAndTitleScreen || state == &HowToPlayScreen || state == &PlayerJoinScreen || state == &GameOver;
+	if (is_static && !IsFading() && idle_frame_interval)
+		return idle_frame_interval;
+	return game_frame_interval;
+}
+
+// the window runs at the rate of its most demanding instance
+time_ns GetFrameInterval() {
+	auto interval = idle_frame_interval;
+	for (auto &instance : instances) {
+		game = &instance; // IsFading reads the current instance
+		if (GetStateFrameInterval(instance.game_state) == game_frame_interval)
+			interval = game_frame_interval;
+	}
+	game = &instances[0];
+	return interval;
+}
+
+void PaceFrame() {
+	frame_pacer.SetInterval(frame_interval_hint);
+	frame_pacer.Wait();
+
+	FramePacer::Jitter jitter;
+	if (frame_pacer.TakeReport(jitter)) {
+		char target[32] = "vsync";
+		if (jitter.interval)
+			snprintf(target, sizeof(target), "%.2fms", time_to_ms_f(jitter.interval));
+		log(format("Frame pacing: target %1, mean %2ms, deviation p50 %3ms p99 %4ms max %5ms, %6 late frames").arg(target).arg(jitter.mean_ms)
+			.arg(jitter.p50_ms).arg(jitter.p99_ms).arg(jitter.max_ms).arg(jitter.late_count));
+	}
+}
+
+//
+// game states of all instances into the draw list, the part of a frame that runs game code
+void RecordInstances() {
+	draw->Clear();
+	TakeInputSnapshot();
+
+	for (auto &instance : instances) {
+		game = &instance;
+		TelemetrySetInstance(int(&instance - instances.data()));
+		if (instances.size() > 1)
+			draw->SetViewport(instance.viewport[0], instance.viewport[1], instance.viewport[2], instance.viewport[3], float(width), float(height));
+
+		game->frame_timers.Advance(GetFrameDuration());
+
+		if (game->game_state()) {
+			game->game_state = game->next_game_state;
+			texture_hints[&instance - instances.data()] = game->game_state;
+			TelemetryLog(TelemetryStateChange, GetGameStateId(game->game_state));
+		}
 
 		DrawFade();
+	}
+	game = &instances[0]; // for the code running between frames, eg. the Lua bindings
+	TelemetrySetInstance(0);
+}
+
+void RecordFrame() {
+	auto frame_allocs = GetThreadAllocStats();
+
+	RecordInstances();
+	frame_interval_hint = GetFrameInterval();
+
+	auto allocs = GetThreadAllocStats() - frame_allocs;
+	ReportFrameAllocs(allocs);
+
+	if (MetricsServerIsRunning())
+		PublishMetrics(allocs);
+}
+
+//
+typedef std::chrono::steady_clock StartupClock;
+
+const StartupClock::time_point startup_start = StartupClock::now(); // set during static initialization
+constexpr int first_frame_target_ms = 300;
+
+int GetStartupTimeMs() { return int(std::chrono::duration_cast<std::chrono::milliseconds>(StartupClock::now() - startup_start).count()); }
+
+// log the duration of a startup phase and when it completed
+void LogStartupPhase(const char *phase, StartupClock::time_point phase_start, StartupClock::time_point phase_end = StartupClock::now(), const char *thread = "main") {
+	auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(phase_end - phase_start).count();
+	auto done_ms = std::chrono::duration_cast<std::chrono::milliseconds>(phase_end - startup_start).count();
+	log(format("Startup: %1 took %2ms on the %3 thread, done at %4ms").arg(phase).arg(int(ms)).arg(thread).arg(int(done_ms)));
+}
+
+bool first_frame_shown{false};
+
+// The SFX are decoded on a thread started as soon as the data is mounted, overlapping the render init and the
+// first frames. It only goes through the engine audio IO, like the headless runs. The mixer then loads them
+// from memory on the main thread.
+std::array<DecodedSound, SfxCount> sfx_decoded;
+std::thread sfx_decode_thread;
+std::atomic<bool> sfx_decode_done{false};
+bool sfx_decode_ok{false};
+StartupClock::time_point sfx_decode_start, sfx_decode_end; // written by the thread before sfx_decode_done
+
+void StartSFXDecode() {
+	sfx_decode_thread = std::thread([] {
+		sfx_decode_start = StartupClock::now();
+		sfx_decode_ok = true;
+		for (int i = 0; i < SfxCount && sfx_decode_ok; ++i)
+			sfx_decode_ok = DecodeSamples(sfx_paths[i], sfx_decoded[i]);
+		sfx_decode_end = StartupClock::now();
+		sfx_decode_done = true;
+	});
+}
+
+void JoinSFXDecode() {
+	if (sfx_decode_thread.joinable())
+		sfx_decode_thread.join();
+}
+
+// decoded samples handed to the mixer as audio data, so that loading a sound does not decode it again
+class PcmAudioData : public AudioData {
+public:
+	explicit PcmAudioData(DecodedSound &&sound) : sound(std::move(sound)) {}
+
+	AudioFormat GetFormat() const override { return sound.format; }
+	State GetState() const override { return pos < sound.samples.size() ? Ready : Ended; }
+	time_ns GetLength() const override { return time_from_sec(int64_t(sound.samples.size() / sound.format.channels)) / sound.format.frequency; }
+
+	bool Seek(time_ns t) override {
+		pos = std::min(size_t(t * sound.format.frequency / time_from_sec(1)) * sound.format.channels, sound.samples.size());
+		return true;
+	}
+
+	size_t GetNextChunk(Data &data) override {
+		constexpr size_t chunk_samples = 16384;
+		auto count = std::min(chunk_samples, sound.samples.size() - pos);
+		if (!count)
+			return 0;
+		data.Write(&sound.samples[pos], count * sizeof(int16_t));
+		pos += count;
+		return count * sizeof(int16_t);
+	}
+
+private:
+	DecodedSound sound;
+	size_t pos{0}; // in samples
+};
+
+bool LoadSoundFXs() {
+	auto mixer = g_plus.get().GetMixer();
+	for (int i = 0; i < SfxCount; ++i)
+		sfx_sounds[i] = mixer->LoadSoundData(std::make_shared<PcmAudioData>(std::move(sfx_decoded[i])), sfx_paths[i]);
+	return bool(sfx_sounds[SfxPiout]);
+}
+
+// Input and audio come up after the first frame, one phase per frame between two frames. The engine is only
+// initialized from the main thread: its input and mixer systems make no promise of being safe to set up while
+// another thread renders and ends frames. In pipelined mode the worker is idle while a phase runs, it only
+// reads the ready flags. Loading the SFX waits for their decoding, a frame at a time.
+enum StartupPhase { StartupInput, StartupAudio, StartupSoundFXs, StartupMusic, StartupDone };
+int startup_phase{StartupInput};
+
+void RunStartupPhase() {
+	if (startup_phase == StartupDone || !first_frame_shown)
+		return;
+
+	auto t = StartupClock::now();
+	switch (startup_phase) {
+		case StartupInput:
+			if (!SetupGamepads()) {
+				startup_failed = true;
+				return;
+			}
+			if (input_sample_rate > 0 && !input_sampler.Start(input_sample_rate)) // polls the devices set up above
+				warn("Failed to start the input sampler, input is polled once per frame");
+			input_ready = true;
+			LogStartupPhase("SetupGamepads", t);
+			break;
+
+		case StartupAudio:
+			if (!g_plus.get().AudioInit()) {
+				startup_failed = true;
+				return;
+			}
+			LogStartupPhase("AudioInit", t);
+			break;
+
+		case StartupSoundFXs:
+			if (!sfx_decode_done)
+				return; // next frame
+			JoinSFXDecode();
+			LogStartupPhase("DecodeSoundFXs", sfx_decode_start, sfx_decode_end, "decode");
+
+			if (!sfx_decode_ok || !LoadSoundFXs()) {
+				startup_failed = true;
+				return;
+			}
+			LogStartupPhase("LoadSoundFXs", t);
+			break;
+
+		case StartupMusic:
+			g_plus.get().GetMixer()->Stream("@data:zik.ogg", Mixer::RepeatState);
+			audio_ready = true;
+			LogStartupPhase("Stream zik.ogg", t);
+			break;
+	}
+	++startup_phase;
+}
+
+// frame capture: -capture writes the presented frames, -capture-headless rasterizes the draw lists on the CPU
+std::unique_ptr<FrameCapture> frame_capture;
+int capture_frame_index{0};
+Picture capture_picture;
+
+void CaptureFramebuffer() { // before Flip
+	auto buffer = frame_capture->Acquire();
+	auto frame_index = capture_frame_index++; // dropped frames leave a gap in the numbering
+	if (!buffer)
+		return;
+
+	g_plus.get().GetRenderer()->CaptureFramebuffer(capture_picture); // synchronous readback, rows bottom up
+	capture_picture.Convert(PictureRGBA8);
+
+	auto row_bytes = size_t(std::min(capture_picture.GetWidth(), frame_capture->GetWidth())) * 4;
+	auto rows = std::min(capture_picture.GetHeight(), frame_capture->GetHeight());
+	auto src = static_cast<const uint8_t *>(capture_picture.GetData());
+
+	for (int y = 0; y < rows; ++y)
+		memcpy(buffer + size_t(y) * frame_capture->GetWidth() * 4, src + size_t(y) * capture_picture.GetStride(), row_bytes);
+
+	frame_capture->Submit(buffer, frame_index);
+}
+
+bool LoadSoftImage(const char *path, SoftImage &image) {
+	Picture picture;
+	if (!LoadPicture(picture, path) || !picture.Convert(PictureRGBA8))
+		return false;
+
+	image.w = picture.GetWidth();
+	image.h = picture.GetHeight();
+	image.rgba.resize(size_t(image.w) * image.h * 4);
+
+	auto src = static_cast<const uint8_t *>(picture.GetData());
+	for (int y = 0; y < image.h; ++y)
+		memcpy(&image.rgba[size_t(y) * image.w * 4], src + size_t(y) * picture.GetStride(), size_t(image.w) * 4);
+	return true;
+}
+
+const SoftImage *GetSoftImage(const char *path, void *) {
+	static std::unordered_map<std::string, SoftImage> images; // the game draws a few dozen images
+
+	auto i = images.find(path);
+	if (i == images.end()) {
+		i = images.emplace(path, SoftImage()).first;
+		if (!LoadSoftImage(path, i->second))
+			warn(format("Capture: failed to load %1").arg(path)); // kept empty, not retried
+	}
+	return &i->second;
+}
+
+// record frames of the attract mode and title screens at 60 fps without render device, rasterized in software
+int RunHeadlessCapture(const char *dir, int frame_count) {
+	headless = true;
+	LoadPlugins();
+	MountData();
+
+	fixed_frame_duration = time_from_sec(1) / 60;
+
+	FrameCapture capture(dir, width, height, true);
+	SoftRaster raster(width, height);
+
+	game->game_state = &AttractMode;
+
+	auto t = std::chrono::steady_clock::now();
+	for (int i = 0; i < frame_count; ++i) {
+		RecordFrame();
+
+		raster.Clear({0, 0, 0, 1});
+		draw->Rasterize(raster, &GetSoftImage, nullptr);
+
+		auto buffer = capture.Acquire(true); // offline, wait for the encoders rather than dropping frames
+		memcpy(buffer, raster.GetPixels(), size_t(width) * height * 4);
+		capture.Submit(buffer, i);
+
+		g_frame_arena.Reset();
+	}
+	capture.Flush();
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+
+	log(format("Capture: %1 frames written to %2 in %3ms, %4ms mean encode").arg(int(capture.GetWrittenCount())).arg(dir).arg(int(elapsed * 1000.0)).arg(capture.GetMeanEncodeMs()));
+	if (capture.GetFailedCount()) {
+		error(format("Capture: failed to write %1 frames to %2").arg(int(capture.GetFailedCount())).arg(dir));
+		return 1;
+	}
+	return 0;
+}
+
+// compare the frames of two capture directories, fail if any pixel is off by more than the threshold
+int RunFrameDiff(const char *dir_a, const char *dir_b, int threshold) {
+	LoadPlugins();
+
+	int frame_count = 0, failed_count = 0;
+	double worst_error = 0;
+	int worst_frame = -1;
+
+	for (int i = 0;; ++i) {
+		auto path_a = FrameCapture::GetFramePath(dir_a, i), path_b = FrameCapture::GetFramePath(dir_b, i);
+
+		SoftImage a, b;
+		bool has_a = LoadSoftImage(path_a.c_str(), a), has_b = LoadSoftImage(path_b.c_str(), b);
+		if (!has_a && !has_b)
+			break;
+		if (has_a != has_b || a.w != b.w || a.h != b.h) {
+			if (has_a && has_b)
+				error(format("frame %1: %2x%3 against %4x%5").arg(i).arg(a.w).arg(a.h).arg(b.w).arg(b.h));
+			else
+				error(format("frame %1: missing from %2").arg(i).arg(has_a ? dir_b : dir_a));
+			++failed_count;
+			++frame_count;
+			continue;
+		}
+
+		auto diff = CompareFrames(a.rgba.data(), a.w * 4, b.rgba.data(), b.w * 4, a.w, a.h, threshold);
+		log(format("frame %1: mean error %2, max %3, %4 pixels over %5").arg(i).arg(diff.mean_error).arg(diff.max_error).arg(diff.differing_pixels).arg(threshold));
+
+		if (diff.differing_pixels)
+			++failed_count;
+		if (diff.mean_error > worst_error) {
+			worst_error = diff.mean_error;
+			worst_frame = i;
+		}
+		++frame_count;
+	}
+
+	if (!frame_count) {
+		error(format("Frame diff: no frames in %1 nor %2").arg(dir_a).arg(dir_b));
+		return 1;
+	}
+
+	log(format("Frame diff: %1 frames, %2 differ, worst mean error %3 at frame %4").arg(frame_count).arg(failed_count).arg(worst_error).arg(worst_frame));
+	return failed_count ? 1 : 0;
+}
+
+// dynamic resolution: the frame is drawn into an offscreen target sized by the controller then upscaled
+// to the window, draw lists keep recording in playfield coordinates
+bool dynamic_resolution{false};
+ResolutionController resolution_controller;
+
+struct ScaledTarget {
+	std::shared_ptr<Texture> color, resolved;
+	std::shared_ptr<RenderTarget> rt, resolve_rt; // resolve_rt only with MSAA
+	int w{0}, h{0};
+};
+
+std::array<ScaledTarget, ResolutionController::level_count> scaled_targets; // created on first use
+
+ScaledTarget &GetScaledTarget(int level) {
+	auto &target = scaled_targets[level];
+	if (target.rt)
+		return target;
+
+	auto &renderer = *g_plus.get().GetRenderer();
+	auto msaa = ResolutionController::GetLevel(level).msaa;
+	ResolutionController::GetTargetSize(level, width, height, target.w, target.h);
+
+	target.color = renderer.NewTexture();
+	renderer.CreateTexture(*target.color, target.w, target.h, TextureRGBA8, msaa == 4 ? TextureMSAA4x : (msaa == 2 ? TextureMSAA2x : TextureNoAA), TextureIsRenderTarget | TextureIsShaderResource, false);
+	target.rt = renderer.NewRenderTarget();
+	renderer.CreateRenderTarget(*target.rt);
+	renderer.SetRenderTargetColorTexture(*target.rt, target.color);
+
+	if (msaa > 1) { // multisampled textures are resolved to a plain one before the upscale
+		target.resolved = renderer.NewTexture();
+		renderer.CreateTexture(*target.resolved, target.w, target.h, TextureRGBA8, TextureNoAA, TextureIsRenderTarget | TextureIsShaderResource, false);
+		target.resolve_rt = renderer.NewRenderTarget();
+		renderer.CreateRenderTarget(*target.resolve_rt);
+		renderer.SetRenderTargetColorTexture(*target.resolve_rt, target.resolved);
+	} else {
+		target.resolved = target.color;
+	}
 
+	log(format("Dynamic resolution: created %1x%2 target, MSAA %3x").arg(target.w).arg(target.h).arg(msaa));
+	return target;
+}
+
+void SubmitScaledFrame(const DrawList &list, int64_t &sound_time) {
+	auto &plus = g_plus.get();
+	auto &renderer = *plus.GetRenderer();
+	auto &render_system = *plus.GetRenderSystem();
+
+	auto previous_level = resolution_controller.GetLevelIndex();
+	auto level = resolution_controller.Update(time_to_ms_f(GetLastFrameDuration()));
+	if (level != previous_level)
+		log(format("Dynamic resolution: level %1, recent frames %2ms").arg(level).arg(int(resolution_controller.GetRecentMs())));
+
+	auto &target = GetScaledTarget(level);
+
+	renderer.SetRenderTarget(target.rt);
+	renderer.SetViewport(fRect(0, 0, float(target.w), float(target.h)));
+	render_system.SetView2D(0, 0, float(width), float(height)); // playfield coordinates map to the whole target
+	plus.Clear(Color::Black);
+	list.Submit();
+	sound_time = InputClock(); // sounds are started last
+	plus.Commit2D();
+
+	if (target.resolve_rt)
+		renderer.BlitRenderTarget(target.rt, target.resolve_rt, fRect(0, 0, float(target.w), float(target.h)), fRect(0, 0, float(target.w), float(target.h)));
+
+	renderer.ClearRenderTarget();
+	renderer.SetViewport(fRect(0, 0, float(width), float(height)));
+	render_system.SetView2D(0, 0, float(width), float(height));
+	plus.Clear(Color::Black);
+	plus.Texture2D(0, 0, float(width) / float(target.w), target.resolved);
+	if (frame_capture)
+		CaptureFramebuffer();
+	plus.Flip();
+}
+
+// shot latency per input type, logged every few dozen shots
+LatencyTracer latency_tracer;
+constexpr uint32_t latency_report_count = 50;
+
+static const char *input_type_names[] = {"gamepad", "keyboard"};
+
+void CompleteLatencyTraces(const DrawList &list, int64_t sound_time, int64_t flip_time) {
+	for (auto &trace : list.GetLatencyTraces()) {
+		latency_tracer.Complete(trace, sound_time, flip_time);
+
+		if (latency_tracer.GetCount(trace.source) < latency_report_count)
+			continue;
+
+		char spans[LatencySpanCount][48]; // not FrameFormat, the frame arena belongs to the recording thread
+		for (int i = 0; i < LatencySpanCount; ++i) {
+			auto &h = latency_tracer.GetHistogram(trace.source, LatencySpan(i));
+			snprintf(spans[i], sizeof(spans[i]), "%.1f/%.1f/%.1fms", h.GetPercentileMs(0.5f), h.GetPercentileMs(0.99f), h.GetMaxMs());
+		}
+
+		log(format("Shot latency (%1, %2 shots, p50/p99/max): input %3, fire %4, sound %5, flip %6").arg(input_type_names[trace.source]).arg(int(latency_report_count))
+			.arg(spans[LatencyToInput]).arg(spans[LatencyToFire]).arg(spans[LatencyToSound]).arg(spans[LatencyToFlip]));
+		latency_tracer.Reset(trace.source);
+	}
+}
+
+void SubmitFrame(const DrawList &list) {
+	UpdateTextureBudget(list); // textures drawn this frame are resident before the draw list needs them
+
+	int64_t sound_time;
+	if (dynamic_resolution) {
+		SubmitScaledFrame(list, sound_time);
+	} else {
+		if (instances.size() > 1) { // the list leaves the viewport of the last instance
+			g_plus.get().GetRenderer()->SetViewport(fRect(0, 0, float(window_width), float(window_height)));
+			g_plus.get().GetRenderSystem()->SetView2D(0, 0, float(window_width), float(window_height));
+		}
+		g_plus.get().Clear(Color::Black);
+		list.Submit();
+		sound_time = InputClock(); // sounds are started last
+		if (frame_capture)
+			CaptureFramebuffer();
 		g_plus.get().Flip();
-		g_plus.get().EndFrame();
-		g_plus.get().UpdateClock();
 	}
 
+	if (!list.GetLatencyTraces().empty())
+		CompleteLatencyTraces(list, sound_time, InputClock());
+
+	if (!first_frame_shown) {
+		first_frame_shown = true;
+
+		auto ms = GetStartupTimeMs();
+		if (ms > first_frame_target_ms)
+			warn(format("Startup: first frame at %1ms, target is %2ms").arg(ms).arg(first_frame_target_ms));
+		else
+			log(format("Startup: first frame at %1ms").arg(ms));
+	}
+}
+
+// records the next frame while the main thread submits the previous one
+class FrameWorker {
+public:
+	FrameWorker() : thread([this]() { Run(); }) {}
+
+	~FrameWorker() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		cv.notify_all();
+		thread.join();
+	}
+
+	void Kick() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			pending = true;
+		}
+		cv.notify_all();
+	}
+
+	void Wait() {
+		std::unique_lock<std::mutex> lock(mutex);
+		cv.wait(lock, [this]() { return !pending; });
+	}
+
+private:
+	void Run() {
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;) {
+			cv.wait(lock, [this]() { return pending || quit; });
+			if (quit)
+				break;
+
+			lock.unlock();
+			RecordFrame();
+			lock.lock();
+
+			pending = false;
+			cv.notify_all();
+		}
+	}
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool pending{false}, quit{false};
+
+	std::thread thread;
+};
+
+// -instances: matches sharing the window, the assets and the device slots
+uint32_t ParseDeviceList(const char *list) {
+	uint32_t mask = 0;
+	for (auto p = list; *p;) {
+		char *end;
+		auto slot = strtol(p, &end, 10);
+		if (end == p || slot < 0 || slot >= long(gamepads.size()))
+			return 0;
+		mask |= 1u << slot;
+		p = *end == ',' ? end + 1 : end;
+	}
+	return mask;
+}
+
+bool InitInstances(int count, const uint32_t *devices, const std::array<int, 4> *viewports) {
+	instances.resize(count);
+	game = &instances[0];
+
+	window_width = window_height = 0;
+	for (int i = 0; i < count; ++i) {
+		auto &instance = instances[i];
+
+		if (devices[i]) {
+			instance.device_mask = devices[i];
+		} else {
+			instance.device_mask = 0;
+			for (size_t d = i; d < gamepads.size(); d += count) // eg. pads 0 and 2 and the ZQD and arrow keys for the first of 2
+				instance.device_mask |= 1u << d;
+		}
+
+		if (viewports[i][2]) {
+			std::copy(viewports[i].begin(), viewports[i].end(), instance.viewport);
+		} else {
+			instance.viewport[0] = i * width;
+			instance.viewport[1] = 0;
+			instance.viewport[2] = width;
+			instance.viewport[3] = height;
+		}
+
+		window_width = std::max(window_width, instance.viewport[0] + instance.viewport[2]);
+		window_height = std::max(window_height, instance.viewport[1] + instance.viewport[3]);
+	}
+
+	for (int i = 0; i < count; ++i)
+		for (int j = 0; j < i; ++j)
+			if (instances[i].device_mask & instances[j].device_mask)
+				warn(format("Instances %1 and %2 share input devices").arg(j).arg(i));
+
+	if (count > 1)
+		log(format("Instances: %1 in a %2x%3 window, %4 bytes of match state each").arg(count).arg(window_width).arg(window_height).arg(int(sizeof(GameInstance))));
+	return window_width > 0 && window_height > 0;
+}
+
+void EndEngineFrame() {
+	std::lock_guard<std::mutex> lock(input_device_mutex); // EndFrame also updates the input devices
+	g_plus.get().EndFrame();
+}
+
+//
+int main(int narg, const char **args) {
+	const char *script_path = nullptr;
+	bool pipelined = false;
+	bool stress = false;
+	const char *capture_dir = nullptr;
+	int metrics_port = 0;
+
+	int instance_count = 1;
+	uint32_t instance_devices[max_instances] = {}; // 0 to assign the devices round robin
+	std::array<int, 4> instance_viewports[max_instances] = {}; // 0 wide to lay the instances side by side
+
+	for (int i = 1; i < narg; ++i) {
+		std::string arg(args[i]);
+		if (arg == "-bench-lua" && i + 1 < narg) {
+			Init();
+			return RunScriptBenchmark(args[i + 1]);
+		} else if (arg == "-bench-env" && i + 1 < narg) {
+			Init();
+			return RunEnvBenchmark(std::max(atoi(args[i + 1]), 1));
+		} else if (arg == "-audio-out" && i + 2 < narg) {
+			Init();
+			return RunAudioOut(args[i + 1], std::max(atoi(args[i + 2]), 1));
+		} else if (arg == "-bench-mixer" && i + 1 < narg) {
+			Init();
+			return RunMixerBenchmark(std::max(atoi(args[i + 1]), 1));
+		} else if (arg == "-bench-overlay" && i + 1 < narg) {
+			Init();
+			return RunOverlayBenchmark(std::max(atoi(args[i + 1]), 1));
+		} else if (arg == "-capture-headless" && i + 2 < narg) {
+			Init();
+			return RunHeadlessCapture(args[i + 1], std::max(atoi(args[i + 2]), 1));
+		} else if (arg == "-frame-diff" && i + 2 < narg) {
+			Init();
+			return RunFrameDiff(args[i + 1], args[i + 2], i + 3 < narg ? atoi(args[i + 3]) : 16);
+		} else if (arg == "-det-check") {
+			Init();
+			return RunDeterminismCheck();
+		} else if (arg == "-alloc-test") {
+			Init();
+			return RunAllocTest();
+		} else if (arg == "-sim-rate" && i + 1 < narg) {
+			sim_step = time_from_sec(1) / std::max(atoi(args[++i]), 1);
+		} else if (arg == "-telemetry" && i + 1 < narg) {
+			if (!TelemetryOpen(args[++i]))
+				warn(format("Failed to open telemetry log %1").arg(args[i]));
+		} else if (arg == "-scale-check") {
+			Init();
+			return RunResolutionCheck(nullptr);
+		} else if (arg == "-scale-trace" && i + 1 < narg) {
+			Init();
+			return RunResolutionCheck(args[i + 1]);
+		} else if (arg == "-texture-budget" && i + 1 < narg) {
+			texture_budget.SetBudget(size_t(std::max(atoi(args[++i]), 1)) * 1024 * 1024);
+		} else if (arg == "-metrics-check" && i + 1 < narg) {
+			Init();
+			auto failure = MetricsServerCheck(uint16_t(atoi(args[i + 1])));
+			if (failure)
+				error(format("Metrics check failed: %1").arg(failure));
+			else
+				log("Metrics check passed");
+			return failure ? 1 : 0;
+		} else if (arg == "-metrics-port" && i + 1 < narg) {
+			metrics_port = atoi(args[++i]);
+		} else if (arg == "-stress" && i + 1 < narg) {
+			stress_ramp = StressRamp(std::max(float(atof(args[++i])), 1.f));
+			stress = true;
+		} else if (arg == "-stress-load" && i + 1 < narg) {
+			if (sscanf(args[++i], "%f,%f,%f", &stress_shots_per_sec, &stress_splats_per_sec, &stress_msgs_per_sec) != 3)
+				warn(format("Invalid stress load %1, expected shots,splats,messages per second").arg(args[i]));
+		} else if (arg == "-input-rate" && i + 1 < narg) {
+			input_sample_rate = std::max(atoi(args[++i]), 0);
+		} else if (arg == "-frame-rate" && i + 1 < narg) {
+			auto hz = atoi(args[++i]);
+			game_frame_interval = hz > 0 ? time_from_sec(1) / hz : 0;
+		} else if (arg == "-idle-rate" && i + 1 < narg) {
+			auto hz = atoi(args[++i]);
+			idle_frame_interval = hz > 0 ? time_from_sec(1) / hz : 0;
+		} else if (arg == "-debug-overlay") {
+			debug_overlay = true;
+		} else if (arg == "-capture" && i + 1 < narg) {
+			capture_dir = args[++i];
+		} else if (arg == "-dynamic-res") {
+			dynamic_resolution = true;
+		} else if (arg == "-instances" && i + 1 < narg) {
+			instance_count = std::min(std::max(atoi(args[++i]), 1), max_instances);
+		} else if (arg == "-instance-devices" && i + 2 < narg) {
+			auto idx = atoi(args[++i]);
+			auto mask = ParseDeviceList(args[++i]);
+			if (idx >= 0 && idx < max_instances && mask)
+				instance_devices[idx] = mask;
+			else
+				warn(format("Invalid devices %1 for instance %2, expected a comma separated list of device slots 0 to 7").arg(args[i]).arg(idx));
+		} else if (arg == "-instance-viewport" && i + 2 < narg) {
+			auto idx = atoi(args[++i]);
+			std::array<int, 4> rect;
+			if (idx >= 0 && idx < max_instances && sscanf(args[++i], "%d,%d,%d,%d", &rect[0], &rect[1], &rect[2], &rect[3]) == 4 && rect[2] > 0 && rect[3] > 0)
+				instance_viewports[idx] = rect;
+			else
+				warn(format("Invalid viewport %1 for instance %2, expected x,y,w,h").arg(args[i]).arg(idx));
+		} else if (arg == "-pipelined") {
+			pipelined = true;
+		} else if (arg == "-lua" && i + 1 < narg) {
+			script_path = args[++i];
+		}
+	}
+
+	if (!InitInstances(instance_count, instance_devices, instance_viewports))
+		return 1;
+
+	if (dynamic_resolution && instances.size() > 1) {
+		warn("Dynamic resolution renders a single instance, disabled");
+		dynamic_resolution = false;
+	}
+
+	auto t = StartupClock::now();
+	Init();
+	LogStartupPhase("Init", t);
+
+	t = StartupClock::now();
+	LoadPlugins();
+	LogStartupPhase("LoadPlugins", t);
+
+	MountData();
+	StartSFXDecode(); // runs along the render init and the first frames
+
+	t = StartupClock::now();
+	if (!g_plus.get().RenderInit(window_width, window_height, dynamic_resolution ? 1 : 4)) { // MSAA moves to the offscreen targets
+		JoinSFXDecode();
+		return 1;
+	}
+	LogStartupPhase("RenderInit", t);
+
+	g_plus.get().SetWindowTitle("Invasion of the Tako Nation - Harfang 3D");
+
+	g_plus.get().SetBlend2D(BlendAlpha);
+
+	// the title screen starts without sound nor input, they come up between the first frames, see RunStartupPhase
+
+	GameState first_state = &Title;
+
+	if (script_path) {
+		script = OpenScript(script_path, "Frame");
+		if (!script) {
+			JoinSFXDecode();
+			return 1;
+		}
+		first_state = &ScriptFrame;
+	} else if (stress) {
+		first_state = &StressInit;
+	}
+
+	for (auto &instance : instances)
+		instance.game_state = first_state;
+
+	InitTextureGroups();
+	for (size_t i = 0; i < instances.size(); ++i)
+		texture_hints[i] = first_state;
+
+	if (capture_dir)
+		frame_capture.reset(new FrameCapture(capture_dir, window_width, window_height, true));
+
+	if (metrics_port) {
+		if (MetricsServerStart(uint16_t(metrics_port)))
+			log(format("Metrics served on http://127.0.0.1:%1/metrics").arg(metrics_port));
+		else
+			warn(format("Failed to start the metrics server on port %1").arg(metrics_port));
+	}
+
+	if (pipelined) {
+		// Game code runs on the worker and only touches the engine through the draw list, the input
+		// snapshot and the clock. The clock is updated by UpdateClock, which only runs while the worker
+		// is idle, so each recorded frame sees a single update of it.
+		FrameWorker worker;
+
+		while (!g_plus.get().IsAppEnded() && !startup_failed && !quit_requested) {
+			auto &submit = *draw;
+			draw = draw == &draw_lists[0] ? &draw_lists[1] : &draw_lists[0];
+
+			worker.Kick();
+			SubmitFrame(submit);
+			worker.Wait();
+
+			EndEngineFrame();
+			RunStartupPhase();
+			g_frame_arena.Reset();
+			PaceFrame();
+			g_plus.get().UpdateClock();
+		}
+	} else {
+		while (!g_plus.get().IsAppEnded() && !startup_failed && !quit_requested) {
+			RecordFrame();
+			SubmitFrame(*draw);
+
+			EndEngineFrame();
+			RunStartupPhase();
+			g_frame_arena.Reset();
+			PaceFrame();
+			g_plus.get().UpdateClock();
+		}
+	}
+
+	input_sampler.Stop();
+	JoinSFXDecode(); // the window closed before the SFX were loaded
+
+	if (startup_failed) {
+		error("Failed to initialize audio or input");
+		return 1;
+	}
+
+	MetricsServerStop();
+	TelemetryClose();
+	if (auto dropped = TelemetryGetDropCount())
+		warn(format("Telemetry: %1 events dropped on a full ring").arg(int64_t(dropped)));
 	exit(0);
 
 	g_plus.get().RenderUninit();
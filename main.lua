@@ -25,6 +25,82 @@ ai_aiming_speed = 0.1
 human_health = 0
 alien_health = 0
 
+-- Lua garbage collector settings
+gc_settings = {
+    zero_garbage = true, -- stop the automatic collector and step it at the end of each frame
+    step_kb = 32, -- collector work per frame in zero garbage mode
+    pause = 200, -- incremental collector pause (automatic mode)
+    stepmul = 200, -- incremental collector step multiplier (automatic mode)
+    report_interval = 300 -- frames between two GC reports, 0 to disable
+}
+
+gc_stats = {frame = 0, alloc_kb = 0, max_alloc_kb = 0, pause = 0, max_pause = 0}
+
+function ApplyGCSettings()
+    collectgarbage("setpause", gc_settings.pause)
+    collectgarbage("setstepmul", gc_settings.stepmul)
+
+    if gc_settings.zero_garbage then
+        collectgarbage("stop")
+    else
+        collectgarbage("restart")
+    end
+end
+
+function GCFrameBegin()
+    gc_stats.frame_start_kb = collectgarbage("count")
+end
+
+function GCFrameEnd()
+    local alloc_kb = collectgarbage("count") - gc_stats.frame_start_kb
+    if alloc_kb < 0 then -- a collection ran during the frame
+        alloc_kb = 0
+    end
+
+    local pause = 0
+    if gc_settings.zero_garbage then
+        local t = hg.time_now() -- wall time, os.clock counts the CPU time of the engine threads as well
+        collectgarbage("step", gc_settings.step_kb)
+        pause = hg.time_to_sec_f(hg.time_now() - t)
+    end
+
+    gc_stats.frame = gc_stats.frame + 1
+    gc_stats.alloc_kb = gc_stats.alloc_kb + alloc_kb
+    gc_stats.max_alloc_kb = math.max(gc_stats.max_alloc_kb, alloc_kb)
+    gc_stats.pause = gc_stats.pause + pause
+    gc_stats.max_pause = math.max(gc_stats.max_pause, pause)
+
+    if gc_settings.report_interval > 0 and gc_stats.frame >= gc_settings.report_interval then
+        local n = gc_stats.frame
+        print(string.format("GC: alloc %.2fKB/frame (max %.2fKB), pause %.3fms/frame (max %.3fms), heap %.0fKB",
+            gc_stats.alloc_kb / n, gc_stats.max_alloc_kb, gc_stats.pause * 1000 / n, gc_stats.max_pause * 1000, collectgarbage("count")))
+        gc_stats.frame, gc_stats.alloc_kb, gc_stats.max_alloc_kb, gc_stats.pause, gc_stats.max_pause = 0, 0, 0, 0, 0
+    end
+end
+
+-- scratch values reused by the frame loop, never keep a reference to them
+scratch_color = hg.Color(1, 1, 1, 1)
+scratch_pos = hg.Vector2(0, 0)
+alien_target_pos = hg.Vector2(0, 0)
+
+white_color = hg.Color(1, 1, 1, 1)
+black_color = hg.Color(0, 0, 0, 1)
+red_color = hg.Color(1, 0, 0, 1)
+donut_color = hg.Color(1, 1, 1, 0.75)
+
+shot_count_text = {}
+for i = 1, 64 do
+    shot_count_text[i] = tostring(i)
+end
+
+function SetColor(col, r, g, b, a)
+    col.r = r
+    col.g = g
+    col.b = b
+    col.a = a
+    return col
+end
+
 piout = nil
 beep = nil
 explosion = nil
@@ -45,14 +121,15 @@ function LoadSoundFXs()
 end
 
 function create_player()
-    p = {}
+    local p = {}
     
     p.pos = hg.Vector2(0, 0)
     p.spd = hg.Vector2(0, 0)
     p.angle = 0
     
     p.msg = ""
-    msg_delay = 0
+    p.msg_delay = 0
+    p.shoots = {} -- GetPlayerShoots result buffer
 
     p.ai = true
     p.ai_angle = 0
@@ -100,9 +177,30 @@ function GetAIDelay()
     return math.random() * (ai_max_delay - ai_min_delay) + ai_min_delay
 end
 
+text_rect_cache = {}
+
 function DrawText2DCentered(x, y, text, size, color, font_path)
-    local rect = plus:GetTextRect(text, size, font_path)
-    plus:Text2D(x - rect:GetWidth() / 2, y + rect:GetHeight() / 2, text, size, color, font_path)
+    local font_key = font_path or "" -- the default font
+    local by_font = text_rect_cache[font_key]
+    if by_font == nil then
+        by_font = {}
+        text_rect_cache[font_key] = by_font
+    end
+
+    local by_size = by_font[size]
+    if by_size == nil then
+        by_size = {}
+        by_font[size] = by_size
+    end
+
+    local rect = by_size[text]
+    if rect == nil then
+        local r = plus:GetTextRect(text, size, font_path)
+        rect = {w = r:GetWidth(), h = r:GetHeight()}
+        by_size[text] = rect
+    end
+
+    plus:Text2D(x - rect.w / 2, y + rect.h / 2, text, size, color, font_path)
 end
 
 function SetPlayerMessage(player, msg) 
@@ -116,8 +214,8 @@ function DrawPlayerMessage(player)
         local y = player.pos.y + 38
 		local alpha = ClampAuto((player.msg_delay) / hg.time_from_sec_f(0.2))
 
-		DrawText2DCentered(x, y, player.msg, 18, hg.Color(0, 0, 0, 0.5 * alpha), "@data:komikax.ttf")
-		DrawText2DCentered(x - 2, y + 2, player.msg, 18, hg.Color(1, 1, 1, 1 * alpha), "@data:komikax.ttf")
+		DrawText2DCentered(x, y, player.msg, 18, SetColor(scratch_color, 0, 0, 0, 0.5 * alpha), "@data:komikax.ttf")
+		DrawText2DCentered(x - 2, y + 2, player.msg, 18, SetColor(scratch_color, 1, 1, 1, 1 * alpha), "@data:komikax.ttf")
 		player.msg_delay = player.msg_delay - hg.GetLastFrameDuration()
     end
 end
@@ -129,7 +227,7 @@ function DrawPlayer(idx, col)
 
 	if #shots > 0 then
 		plus:Sprite2D(player.pos.x, player.pos.y, 160, "@data:drone_buffer.png", players_color[idx])
-		plus:Text2D(player.pos.x - 6, player.pos.y - 12, #shots, 32, players_color[idx], "@data:impact.ttf")
+		plus:Text2D(player.pos.x - 6, player.pos.y - 12, shot_count_text[#shots] or tostring(#shots), 32, players_color[idx], "@data:impact.ttf")
 	else
 		plus:Sprite2D(player.pos.x, player.pos.y, 160, "@data:drone.png", players_color[idx])
     end
@@ -139,13 +237,12 @@ function DrawPlayer(idx, col)
 
 		local tgt_col
 		if shot.player_seq_idx == 4 then
-			tgt_col = hg.Color.Red
+			tgt_col = red_color
 		else
 			local tgt_idx = shot.player_seq[shot.player_seq_idx + 1]
 			tgt_col = players_color[tgt_idx]
         end
 
-		local dir = AngleToDirection(player.angle)
 		plus:RotatedSprite2D(player.pos.x, player.pos.y, player.angle - math.rad(90), 160, "@data:drone_arrow.png", tgt_col)
     end
 end
@@ -154,11 +251,15 @@ function PlayerFireShot(player_idx, idx)
 	local player = players[player_idx]
 	local shoot = shoots[idx]
 
-    local dir = AngleToDirection(player.angle)
-	shoot.pos = player.pos + dir * player_radius -- prevent self collision
-	shoot.spd = dir * shoot_speed
+	local angle = -player.angle + math.rad(90)
+	local dir_x, dir_y = math.sin(angle), math.cos(angle)
+	shoot.pos.x = player.pos.x + dir_x * player_radius -- prevent self collision
+	shoot.pos.y = player.pos.y + dir_y * player_radius
+	shoot.spd.x = dir_x * shoot_speed
+	shoot.spd.y = dir_y * shoot_speed
 	shoot.hold_until = 0
-	player.spd = player.spd + (shoot.spd * player_decoy_coef)
+	player.spd.x = player.spd.x + shoot.spd.x * player_decoy_coef
+	player.spd.y = player.spd.y + shoot.spd.y * player_decoy_coef
 	assert(shoot.player_seq_idx < 5)
 	shoot.player_seq_idx = shoot.player_seq_idx + 1
 
@@ -167,7 +268,9 @@ end
 
 function GetShootNextTargetPos(shot)
 	if (shot.player_seq_idx + 1) == 5 then -- sequence end: shot alien!
-        return hg.Vector2(width / 2, 0)
+        alien_target_pos.x = width / 2
+        alien_target_pos.y = 0
+        return alien_target_pos
     end
 
 	local tgt_idx = shot.player_seq[shot.player_seq_idx + 1]
@@ -177,8 +280,10 @@ end
 function UpdatePlayer(idx)
 	local player = players[idx]
 
-	player.pos = player.pos + player.spd
-	player.spd = player.spd * player_damping
+	player.pos.x = player.pos.x + player.spd.x
+	player.pos.y = player.pos.y + player.spd.y
+	player.spd.x = player.spd.x * player_damping
+	player.spd.y = player.spd.y * player_damping
 
 	if player.ai then
 		local shots = GetPlayerShoots(idx)
@@ -186,8 +291,7 @@ function UpdatePlayer(idx)
 		if #shots > 0 then
 			local shot = shoots[shots[1]]
 			local tgt_pos = GetShootNextTargetPos(shot)
-			local dir = (tgt_pos - player.pos):Normalized()
-			player.ai_angle = DirectionToAngle(dir) + FRRand(-ai_precision_delta, ai_precision_delta)
+			player.ai_angle = math.atan(tgt_pos.y - player.pos.y, tgt_pos.x - player.pos.x) + FRRand(-ai_precision_delta, ai_precision_delta)
 			player.angle = player.angle + ((player.ai_angle - player.angle) * ai_aiming_speed)
 
 			player.ai_shot_delay = player.ai_shot_delay - hg.GetLastFrameDuration()
@@ -236,15 +340,17 @@ function PlayerCollidePlayfield(player)
 end
 
 function PlayerCollidePlayer(a, b)
-	local d = b.pos - a.pos
-	local l = d:Len()
+	local dx, dy = b.pos.x - a.pos.x, b.pos.y - a.pos.y
+	local l = math.sqrt(dx * dx + dy * dy)
 
 	if l < player_radius * 2 then
-		local k = (player_radius * 2 - l) * player_to_player_collision_damping
-		local v = d * (k / l)
+		local k = (player_radius * 2 - l) * player_to_player_collision_damping / l
+		local vx, vy = dx * k, dy * k
 
-		b.spd = b.spd + v
-		a.spd = a.spd - v
+		b.spd.x = b.spd.x + vx
+		b.spd.y = b.spd.y + vy
+		a.spd.x = a.spd.x - vx
+		a.spd.y = a.spd.y - vy
 
 		plus:GetMixer():Start(bidon)
     end
@@ -281,14 +387,33 @@ function UpdatePlayerInputs(idx, device)
 end
 
 function ShootAtTarget(shoot, tgt)
-	shoot.spd = (tgt - shoot.pos):Normalized() * shoot_speed
+    local dx, dy = tgt.x - shoot.pos.x, tgt.y - shoot.pos.y
+    local k = shoot_speed / math.sqrt(dx * dx + dy * dy)
+    shoot.spd.x = dx * k
+    shoot.spd.y = dy * k
     shoot.hold_until = 0
     return shoot
 end
 
+shoots = {}
+shoot_pool = {}
+
+function AllocShoot()
+    local n = #shoot_pool
+    if n > 0 then
+        local shoot = shoot_pool[n]
+        shoot_pool[n] = nil
+        return shoot
+    end
+    return {player_seq = {}, pos = hg.Vector2(0, 0), spd = hg.Vector2(0, 0)}
+end
+
+function FreeShoot(shoot)
+    shoot_pool[#shoot_pool + 1] = shoot
+end
+
 function InitShoot()
-    local shoot = {}
-    shoot.player_seq = {}
+    local shoot = AllocShoot()
     for i = 1, 4, 1 do
         shoot.player_seq[i] = i
     end
@@ -304,19 +429,27 @@ function InitShoot()
     end
 
 	shoot.player_seq_idx = 1
-	shoot.pos = hg.Vector2(width / 2, 0)
+	shoot.pos.x = width / 2
+	shoot.pos.y = 0
 	shoot.hold_until = 0 
 
     shoot = ShootAtTarget(shoot, players[shoot.player_seq[shoot.player_seq_idx]].pos)
     return shoot
 end
 
+-- the returned table is reused by the next call for the same player
 function GetPlayerShoots(idx)
-	local shoot_idxs = {}
-    for i, shoot in ipairs(shoots) do
+	local shoot_idxs = players[idx].shoots
+    local n = 0
+    for i = 1, #shoots do
+        local shoot = shoots[i]
 		if shoot.hold_until ~= 0 and (shoot.player_seq[shoot.player_seq_idx] == idx) then
-            table.insert(shoot_idxs, i)
+            n = n + 1
+            shoot_idxs[n] = i
         end
+    end
+    for i = #shoot_idxs, n + 1, -1 do
+        shoot_idxs[i] = nil
     end
 	return shoot_idxs
 end
@@ -330,7 +463,9 @@ function SetEarthMessage(msg)
 end
 
 function GetEarthPos() 
-    return hg.Vector2(width / 2, height - 120)
+    scratch_pos.x = width / 2
+    scratch_pos.y = height - 120
+    return scratch_pos
 end
 
 function DrawEarthMessage()
@@ -338,8 +473,8 @@ function DrawEarthMessage()
 		local pos = GetEarthPos()
 		local alpha = ClampAuto((earth_msg_duration) / hg.time_from_sec_f(0.2))
 
-		DrawText2DCentered(pos.x, pos.y, earth_msg, 64, hg.Color(0, 0, 0, 0.75 * alpha), "@data:komikax.ttf")
-		DrawText2DCentered(pos.x - 8, pos.y + 8, earth_msg, 64, hg.Color(1, 1, 1, 1 * alpha), "@data:komikax.ttf")
+		DrawText2DCentered(pos.x, pos.y, earth_msg, 64, SetColor(scratch_color, 0, 0, 0, 0.75 * alpha), "@data:komikax.ttf")
+		DrawText2DCentered(pos.x - 8, pos.y + 8, earth_msg, 64, SetColor(scratch_color, 1, 1, 1, 1 * alpha), "@data:komikax.ttf")
 		earth_msg_duration = earth_msg_duration - hg.GetLastFrameDuration()
     end
 end
@@ -360,7 +495,9 @@ function GetAlienPos()
 	x = x + offset
 	y = y + offset
 
-	return hg.Vector2(x, y)
+	scratch_pos.x = x
+	scratch_pos.y = y
+	return scratch_pos
 end
 
 function DrawAlienMessage()
@@ -368,15 +505,15 @@ function DrawAlienMessage()
 		local pos = GetAlienPos()
 		local alpha = ClampAuto((alien_msg_duration) / hg.time_from_sec_f(0.2))
 
-		DrawText2DCentered(pos.x, pos.y, alien_msg, 64, hg.Color(0, 0, 0, 0.75 * alpha), "@data:komikax.ttf")
-		DrawText2DCentered(pos.x - 8, pos.y + 8, alien_msg, 64, hg.Color(1, 0, 0, 1 * alpha), "@data:komikax.ttf")
+		DrawText2DCentered(pos.x, pos.y, alien_msg, 64, SetColor(scratch_color, 0, 0, 0, 0.75 * alpha), "@data:komikax.ttf")
+		DrawText2DCentered(pos.x - 8, pos.y + 8, alien_msg, 64, SetColor(scratch_color, 1, 0, 0, 1 * alpha), "@data:komikax.ttf")
 		alien_msg_duration = alien_msg_duration - hg.GetLastFrameDuration()
     end
 end
 
 function SpawnBloodSplatFX(pos, path)
 	for i = 0, 3, 1 do
-		SpawnFX(pos.x + FRRand(-width * 0.5, width * 0.5), pos.y + FRRand(-20, 20), path, FRRand(200, 600), FRRand(0, 2), hg.time_from_sec(1), hg.time_from_sec_f(FRRand(0, 1)), hg.Color(1, 1, 1), 0)
+		SpawnFX(pos.x + FRRand(-width * 0.5, width * 0.5), pos.y + FRRand(-20, 20), path, FRRand(200, 600), FRRand(0, 2), hg.time_from_sec(1), hg.time_from_sec_f(FRRand(0, 1)), white_color, 0)
     end
 end
 
@@ -386,12 +523,14 @@ function UpdateShoot(idx)
     local out_of_bound = false
 
 	if shoot.hold_until == 0 then
-        shoot.pos = shoot.pos + shoot.spd
+        shoot.pos.x = shoot.pos.x + shoot.spd.x
+        shoot.pos.y = shoot.pos.y + shoot.spd.y
 
 		-- detect drone collision
 		for i = 1, 4, 1 do
 			local player = players[i]
-			if hg.Vector2.Dist(shoot.pos, player.pos) < (shoot_radius + player_radius) then
+			local dx, dy = shoot.pos.x - player.pos.x, shoot.pos.y - player.pos.y
+			if dx * dx + dy * dy < (shoot_radius + player_radius) * (shoot_radius + player_radius) then
 				local correct_transfer = true
 
 				if shoot.player_seq_idx == 5 then -- alien expected
@@ -406,9 +545,10 @@ function UpdateShoot(idx)
 
 				if correct_transfer then
 					shoot.hold_until = shoot_hold_duration
-					player.spd = player.spd + (shoot.spd * shoot_to_player_transfer_coef)
+					player.spd.x = player.spd.x + shoot.spd.x * shoot_to_player_transfer_coef
+					player.spd.y = player.spd.y + shoot.spd.y * shoot_to_player_transfer_coef
 
-					SpawnFX(player.pos.x, player.pos.y, "@data:fx_donut.png", 200, 0, hg.time_from_sec_f(0.2), 0, hg.Color(1, 1, 1, 0.75), 8)
+					SpawnFX(player.pos.x, player.pos.y, "@data:fx_donut.png", 200, 0, hg.time_from_sec_f(0.2), 0, donut_color, 8)
                 end
             end
         end
@@ -463,18 +603,23 @@ function UpdateShoot(idx)
 end
 
 function UpdateShoots()
-    local shoots_alive = {}
-	for i = 1, #shoots do
-        if not UpdateShoot(i) then
-            table.insert(shoots_alive, shoots[i])
+    local n, count = 0, #shoots
+	for i = 1, count do
+        if UpdateShoot(i) then
+            FreeShoot(shoots[i])
+        else
+            n = n + 1
+            shoots[n] = shoots[i]
         end
     end
-    shoots = shoots_alive
+    for i = count, n + 1, -1 do
+        shoots[i] = nil
+    end
 end
 
 function DrawShoot(shoot)
 	if shoot.hold_until == 0 then
-		plus:RotatedSprite2D(shoot.pos.x, shoot.pos.y, DirectionToAngle(shoot.spd), 150, "@data:drone_shoot.png", hg.Color.White, 93 / 150, 0.5)
+		plus:RotatedSprite2D(shoot.pos.x, shoot.pos.y, DirectionToAngle(shoot.spd), 150, "@data:drone_shoot.png", white_color, 93 / 150, 0.5)
     end
 end
 
@@ -500,10 +645,14 @@ function HeuristicSpawnShoot()
     end
 end
 
+life_bar_path = {}
+for i = 0, 10 do
+    life_bar_path[i] = "@data:life_bar_"..(i * 10)..".png"
+end
+
 function DrawHealthBar(x, y, health)
-	local idx = Clamp(math.floor((health + 9) / 10), 0, 10) * 10
-	local path = "@data:life_bar_"..idx..".png"
-	plus:Image2D(x, y, 1, path)
+	local idx = Clamp(math.floor((health + 9) / 10), 0, 10)
+	plus:Image2D(x, y, 1, life_bar_path[idx])
 end
 
 function DrawUI()
@@ -513,8 +662,8 @@ function DrawUI()
 	DrawHealthBar(80 + 40, height - 200, alien_health)
 	DrawHealthBar(width - 80 - 40 - 230, height - 200, human_health)
 
-	for k, player in pairs(players) do
-		DrawPlayerMessage(player)
+	for i = 1, #players do
+		DrawPlayerMessage(players[i])
     end
 	DrawEarthMessage() 
 	DrawAlienMessage()
@@ -540,45 +689,59 @@ end
 
 fxs = {}
 
+fx_pool = {}
+
 function DrawFXs()
 	local k_fade = hg.time_from_sec_f(0.25)
 
-    for k, fx in pairs(fxs) do 
+    for i = 1, #fxs do
+        local fx = fxs[i]
 
         if fx.delay > 0 then
 			fx.delay = fx.delay - hg.GetLastFrameDuration()
 		else 
-			local alpha = ClampAuto(fx.duration / k_fade)
-			local col = fx.color
-			col.a = col.a * alpha
+			fx.alpha = fx.alpha * ClampAuto(fx.duration / k_fade) -- compounds frame after frame, as when the color was faded in place
+			local col = SetColor(scratch_color, fx.color.r, fx.color.g, fx.color.b, fx.alpha)
 			plus:RotatedSprite2D(fx.pos.x, fx.pos.y, fx.rotation, fx.size, fx.img, col)
 			fx.size = fx.size + fx.size_spd
 			fx.duration = fx.duration - hg.GetLastFrameDuration()
         end
     end
 
-    alive_fxs = {}
-
-    for k, fx in pairs(fxs) do 
+    local n, count = 0, #fxs
+    for i = 1, count do
+        local fx = fxs[i]
         if fx.duration >= 0 then
-            table.insert(alive_fxs, fx)
+            n = n + 1
+            fxs[n] = fx
+        else
+            fx_pool[#fx_pool + 1] = fx
         end
     end
-
-    fxs = alive_fxs
+    for i = count, n + 1, -1 do
+        fxs[i] = nil
+    end
 end
 
 function SpawnFX(x, y, img, size, rotation, duration, delay, color, size_spd)
-    fx = {}
+    local fx = fx_pool[#fx_pool]
+    if fx ~= nil then
+        fx_pool[#fx_pool] = nil
+    else
+        fx = {pos = hg.Vector2(0, 0)}
+    end
+
     fx.img = img
-	fx.pos = hg.Vector2(x, y)
+	fx.pos.x = x
+	fx.pos.y = y
 	fx.size = size
 	fx.rotation = rotation
 	fx.delay = delay
 	fx.duration = duration
-	fx.color = color
+	fx.color = color -- shared, the fade goes to fx.alpha
+	fx.alpha = color.a
     fx.size_spd = size_spd
-    table.insert( fxs, #fxs + 1, fx)
+    fxs[#fxs + 1] = fx
 end
 
 fade_color = hg.Color(1, 1, 1, 0)
@@ -611,11 +774,12 @@ function FadeToAuto(color)
 end
 
 function DrawFade()
-    local col = hg.Color()
+    local col
 
 	if fade_duration > 0 then
 		local k = hg.time_to_sec_f(fade_duration) / hg.time_to_sec_f(fade_t)
-		col = fade_color * k + fade_to * (1 - k)
+		col = SetColor(scratch_color, fade_color.r * k + fade_to.r * (1 - k), fade_color.g * k + fade_to.g * (1 - k),
+			fade_color.b * k + fade_to.b * (1 - k), fade_color.a * k + fade_to.a * (1 - k))
 		fade_duration = fade_duration - hg.GetLastFrameDuration()
 	else
         fade_color = fade_to
@@ -688,7 +852,13 @@ function FRand(angle)
 end
 
 function GameInit()
+    for i = 1, #fxs do
+        fx_pool[#fx_pool + 1] = fxs[i]
+    end
     fxs = {}
+    for i = 1, #shoots do
+        FreeShoot(shoots[i])
+    end
 	shoots = {}
 
 	earth_msg_duration = 0
@@ -958,19 +1128,23 @@ function Lerp(a, b, t)
     return (b - a) * t + a
 end
 
+intro_text_path = {}
+for i = 1, 4 do
+    intro_text_path[i] = "@data:intro_text0"..i..".png"
+end
+
 function DrawTitle()
     plus:Image2D(0, 0, 1, "@data:intro_bg.jpg")
 
     local t_earth = Clamp(hg.time_to_sec_f(intro_t) / 18, 0, 1)
-    local earth_pos = Lerp(hg.Vector2(0, -400), hg.Vector2(0, 0), t_earth)
 
-    plus:Image2D(earth_pos.x, earth_pos.y, 1, "@data:intro_earth.png")
+    plus:Image2D(0, -400 * (1 - t_earth), 1, "@data:intro_earth.png")
     if intro_seq >= 4 then
         plus:Image2D(width -455, height -520, 1, "@data:intro_alien.png")
     end
 
     if intro_seq > 0 then
-        plus:Image2D(0, height / 2 -140, 1, "@data:intro_text0"..Clamp(intro_seq, 1, 4)..".png")
+        plus:Image2D(0, height / 2 -140, 1, intro_text_path[Clamp(intro_seq, 1, 4)])
     end
 
     if intro_t % hg.time_from_sec_f(1) > hg.time_from_sec_f(0.5) then
@@ -1079,14 +1253,15 @@ function KeyboardTestInput(device, kbd_cf_idx, test)
     return false
 end
 
+function TestWasDown(device, btn) return device.device:WasDown(btn) end
+function TestWasPressed(device, btn) return device.device:WasPressed(btn) end
+
 function KeyboardInputWasDown(device, kbd_cf_idx)
-    local test = function(device, btn) return device.device:WasDown(btn) end
-    return KeyboardTestInput(device, kbd_cf_idx, test)
+    return KeyboardTestInput(device, kbd_cf_idx, TestWasDown)
 end
 
 function KeyboardInputWasPressed(device, kbd_cf_idx)
-    local test = function(device, btn) return device.device:WasPressed(btn) end
-    return KeyboardTestInput(device, kbd_cf_idx, test)
+    return KeyboardTestInput(device, kbd_cf_idx, TestWasPressed)
 end
 
 function InputDeviceWasButtonPressed(device)
@@ -1105,12 +1280,10 @@ end
 
 function InputDeviceGetAngle(device)
     if device.type == 'gamepad' then
-        local v = hg.Vector2(device.device:GetValue(hg.InputAxisX), device.device:GetValue(hg.InputAxisY))
-        local l = v:Len()
+        local x, y = device.device:GetValue(hg.InputAxisX), device.device:GetValue(hg.InputAxisY)
 
-        if l > 0.25 then
-            v = v / l
-            device.angle = math.atan(v.y, v.x)
+        if x * x + y * y > 0.25 * 0.25 then
+            device.angle = math.atan(y, x)
         end
 
     elseif device.type == 'keyboard' then
@@ -1172,8 +1345,12 @@ end
 
 game_state = Title
 
+ApplyGCSettings()
+
 while not plus:IsAppEnded() do
-    plus:Clear(hg.Color.Black)
+    GCFrameBegin()
+
+    plus:Clear(black_color)
     
     if game_state() then
         game_state = next_game_state
@@ -1184,6 +1361,8 @@ while not plus:IsAppEnded() do
     plus:Flip()
     plus:EndFrame()
     plus:UpdateClock()
+
+    GCFrameEnd()
 end
 
 --exit(0)
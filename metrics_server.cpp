@@ -0,0 +1,282 @@
+#include "metrics_server.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET Socket;
+#define CloseSocket closesocket
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int Socket;
+#define INVALID_SOCKET (-1)
+#define CloseSocket close
+#endif
+
+namespace metrics {
+// triple buffer: the publisher owns back, the server owns front, middle holds the latest
+// publication with fresh_bit set until the server picks it up
+MetricsSample samples[3];
+std::atomic<uint8_t> middle{1};
+uint8_t back{0}, front{2};
+constexpr uint8_t fresh_bit = 4;
+
+Socket listener = INVALID_SOCKET;
+std::thread server;
+std::atomic<bool> running{false};
+
+float Percentile(float *v, int count, float p) {
+	auto nth = v + std::min(int(count * p), count - 1);
+	std::nth_element(v, nth, v + count);
+	return *nth;
+}
+
+std::string FormatSample(const MetricsSample &s) {
+	float frames[metrics_frame_window];
+	int count = int(std::min<uint64_t>(s.frame_count, metrics_frame_window));
+	std::copy(s.frame_ms, s.frame_ms + count, frames);
+
+	std::string out;
+	char line[256];
+	auto add = [&](const char *fmt, auto... args) {
+		snprintf(line, sizeof(line), fmt, args...);
+		out += line;
+	};
+
+	add("# TYPE tako_frame_ms summary\n");
+	if (count) {
+		add("tako_frame_ms{quantile=\"0.5\"} %.3f\n", Percentile(frames, count, 0.5f));
+		add("tako_frame_ms{quantile=\"0.9\"} %.3f\n", Percentile(frames, count, 0.9f));
+		add("tako_frame_ms{quantile=\"0.99\"} %.3f\n", Percentile(frames, count, 0.99f));
+	}
+	add("tako_frames_total %llu\n", (unsigned long long)s.frame_count);
+	add("# TYPE tako_ticks_total counter\ntako_ticks_total %llu\n", (unsigned long long)s.tick_count);
+	add("# TYPE tako_ticks_per_sec gauge\ntako_ticks_per_sec %.1f\n", s.ticks_per_sec);
+	add("# TYPE tako_shoots gauge\ntako_shoots %u\n", s.shoot_count);
+	add("# TYPE tako_fxs gauge\ntako_fxs %u\n", s.fx_count);
+	add("# TYPE tako_frame_allocs gauge\ntako_frame_allocs %u\n", s.frame_allocs);
+	add("# TYPE tako_frame_alloc_bytes gauge\ntako_frame_alloc_bytes %u\n", s.frame_alloc_bytes);
+	add("# TYPE tako_mixer_starts_total counter\ntako_mixer_starts_total %llu\n", (unsigned long long)s.mixer_starts);
+	add("# TYPE tako_telemetry_dropped_total counter\ntako_telemetry_dropped_total %llu\n", (unsigned long long)s.telemetry_dropped);
+	add("# TYPE tako_game_state gauge\n");
+	for (int i = 0; i < s.instance_count && i < metrics_max_instances; ++i)
+		add("tako_game_state{instance=\"%d\",name=\"%s\"} %d\n", i, s.game_state_name[i] ? s.game_state_name[i] : "", s.game_state[i]);
+	add("# TYPE tako_uptime_seconds gauge\ntako_uptime_seconds %.3f\n", s.uptime_sec);
+	return out;
+}
+
+constexpr int request_timeout_ms = 2000; // a client sending nothing does not hold the server
+constexpr int poll_ms = 100; // stop requests are checked at this period while waiting on a client
+
+bool WaitReadable(Socket s, int ms) {
+	fd_set fds;
+	FD_ZERO(&fds);
+	FD_SET(s, &fds);
+
+	timeval timeout{ms / 1000, (ms % 1000) * 1000};
+	return select(int(s + 1), &fds, nullptr, nullptr, &timeout) > 0;
+}
+
+void SetSendTimeout(Socket s, int ms) {
+#if defined(_WIN32)
+	DWORD timeout = ms;
+#else
+	timeval timeout{ms / 1000, (ms % 1000) * 1000};
+#endif
+	setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (const char *)&timeout, sizeof(timeout));
+}
+
+int MsSince(std::chrono::steady_clock::time_point t) { return int(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t).count()); }
+
+void Serve(Socket client) {
+	char request[1024];
+	int size = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	while (size < int(sizeof(request)) - 1) { // read the request header, the body is ignored
+		if (!running || MsSince(start) >= request_timeout_ms) {
+			CloseSocket(client); // stopping or idle client, no response
+			return;
+		}
+		if (!WaitReadable(client, poll_ms))
+			continue;
+
+		auto n = recv(client, request + size, int(sizeof(request)) - 1 - size, 0);
+		if (n <= 0)
+			break;
+		size += int(n);
+		request[size] = 0;
+		if (strstr(request, "\r\n\r\n"))
+			break;
+	}
+
+	if (middle.load(std::memory_order_relaxed) & fresh_bit)
+		front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+
+	auto body = FormatSample(samples[front]);
+	char header[160];
+	snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %d\r\nConnection: close\r\n\r\n", int(body.size()));
+
+	auto response = std::string(header) + body;
+	SetSendTimeout(client, request_timeout_ms); // a client that stops reading does not hold the server either
+	send(client, response.data(), int(response.size()), 0);
+	CloseSocket(client);
+}
+
+void Run() {
+	while (running) {
+		if (!WaitReadable(listener, poll_ms)) // check for stop requests
+			continue;
+
+		auto client = accept(listener, nullptr, nullptr);
+		if (client != INVALID_SOCKET)
+			Serve(client);
+	}
+}
+Socket Connect(uint16_t port) {
+	auto s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (s == INVALID_SOCKET)
+		return s;
+
+	sockaddr_in addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (connect(s, (sockaddr *)&addr, sizeof(addr)) != 0) {
+		CloseSocket(s);
+		return INVALID_SOCKET;
+	}
+	return s;
+}
+
+// GET /metrics as a client would, the response until the server closes
+bool Get(uint16_t port, std::string &response) {
+	auto s = Connect(port);
+	if (s == INVALID_SOCKET)
+		return false;
+
+	static const char request[] = "GET /metrics HTTP/1.0\r\nHost: 127.0.0.1\r\n\r\n";
+	send(s, request, int(sizeof(request) - 1), 0);
+
+	auto start = std::chrono::steady_clock::now();
+	char buffer[1024];
+	while (MsSince(start) < request_timeout_ms * 3) {
+		if (!WaitReadable(s, poll_ms))
+			continue;
+		auto n = recv(s, buffer, int(sizeof(buffer)), 0);
+		if (n <= 0)
+			break;
+		response.append(buffer, size_t(n));
+	}
+	CloseSocket(s);
+	return !response.empty();
+}
+} // namespace metrics
+
+using namespace metrics;
+
+bool MetricsServerStart(uint16_t port) {
+	if (running)
+		return false;
+
+#if defined(_WIN32)
+	WSADATA wsa;
+	if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+		return false;
+#endif
+
+	listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listener == INVALID_SOCKET)
+		return false;
+
+	int reuse = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char *)&reuse, sizeof(reuse));
+
+	sockaddr_in addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // never exposed beyond the machine
+
+	if (bind(listener, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 4) != 0) {
+		CloseSocket(listener);
+		listener = INVALID_SOCKET;
+		return false;
+	}
+
+	running = true;
+	server = std::thread(Run);
+	return true;
+}
+
+void MetricsServerStop() {
+	if (!running)
+		return;
+
+	running = false;
+	server.join();
+	CloseSocket(listener);
+	listener = INVALID_SOCKET;
+
+#if defined(_WIN32)
+	WSACleanup();
+#endif
+}
+
+bool MetricsServerIsRunning() { return running; }
+
+void MetricsPublish(const MetricsSample &sample) {
+	samples[back] = sample;
+	back = middle.exchange(back | fresh_bit, std::memory_order_acq_rel) & 3;
+}
+
+const char *MetricsServerCheck(uint16_t port) {
+	if (!MetricsServerStart(port))
+		return "failed to start the server";
+
+	MetricsSample sample{};
+	sample.frame_count = 1;
+	sample.frame_ms[0] = 16.f;
+	sample.instance_count = 1;
+	sample.game_state_name[0] = "Check";
+	MetricsPublish(sample);
+
+	const char *failure = nullptr;
+
+	// an idle client is dropped after the request timeout, the next one is still served
+	auto idle = Connect(port);
+	std::string response;
+	if (idle == INVALID_SOCKET)
+		failure = "failed to connect an idle client";
+	else if (!Get(port, response))
+		failure = "no response after an idle client";
+	else if (response.compare(0, 15, "HTTP/1.0 200 OK") != 0 || response.find("tako_frames_total 1\n") == std::string::npos)
+		failure = "unexpected response";
+
+	if (idle != INVALID_SOCKET)
+		CloseSocket(idle);
+
+	// stopping while the server waits on an idle client
+	idle = Connect(port);
+	std::this_thread::sleep_for(std::chrono::milliseconds(poll_ms * 2)); // accepted and being served
+
+	auto t = std::chrono::steady_clock::now();
+	MetricsServerStop();
+	if (!failure && MsSince(t) > poll_ms * 5)
+		failure = "stop waited on an idle client";
+
+	if (idle != INVALID_SOCKET)
+		CloseSocket(idle);
+	return failure;
+}
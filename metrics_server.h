@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+// Local metrics endpoint: a background thread serves the latest sample in the
+// Prometheus text format over HTTP on 127.0.0.1, eg. curl http://127.0.0.1:9100/metrics
+//
+// The game thread fills a sample once per frame and publishes it through a
+// triple buffer: publishing is a copy and an atomic exchange, it never waits
+// on the server.
+constexpr int metrics_frame_window = 128; // frames kept for the frame time percentiles
+constexpr int metrics_max_instances = 8; // game instances reported, see -instances
+
+struct MetricsSample {
+	float frame_ms[metrics_frame_window]; // ring, the last frame_count ones are valid
+	uint64_t frame_count;
+
+	uint64_t tick_count;
+	float ticks_per_sec; // over the last second
+
+	uint32_t shoot_count, fx_count;
+	uint32_t frame_allocs, frame_alloc_bytes; // last frame
+	uint64_t mixer_starts;
+	uint64_t telemetry_dropped; // events dropped on a full telemetry ring
+
+	int instance_count;
+	int game_state[metrics_max_instances]; // per instance
+	const char *game_state_name[metrics_max_instances]; // static strings
+
+	double uptime_sec;
+};
+
+bool MetricsServerStart(uint16_t port);
+void MetricsServerStop();
+bool MetricsServerIsRunning();
+
+/// Serve a sample on port and query it with local clients, one of them idle. Null on success, the failure otherwise.
+/// The server must not be running.
+const char *MetricsServerCheck(uint16_t port);
+
+/// Copy the sample for the server, call from a single thread.
+void MetricsPublish(const MetricsSample &sample);
@@ -0,0 +1,209 @@
+#include "png_encoder.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+uint32_t crc_table[256];
+
+void InitCRCTable() {
+	for (uint32_t n = 0; n < 256; ++n) {
+		auto c = n;
+		for (int k = 0; k < 8; ++k)
+			c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+		crc_table[n] = c;
+	}
+}
+
+struct CRCInit {
+	CRCInit() { InitCRCTable(); }
+} crc_init;
+
+uint32_t CRC(const uint8_t *p, size_t n, uint32_t crc = 0xffffffffu) {
+	for (size_t i = 0; i < n; ++i)
+		crc = crc_table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+uint32_t Adler32(const uint8_t *p, size_t n) {
+	uint32_t a = 1, b = 0;
+	while (n) {
+		auto block = std::min<size_t>(n, 5552); // largest run without overflowing b
+		for (size_t i = 0; i < block; ++i) {
+			a += p[i];
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+		p += block;
+		n -= block;
+	}
+	return (b << 16) | a;
+}
+
+void PutU32(std::vector<uint8_t> &out, uint32_t v) {
+	out.push_back(uint8_t(v >> 24));
+	out.push_back(uint8_t(v >> 16));
+	out.push_back(uint8_t(v >> 8));
+	out.push_back(uint8_t(v));
+}
+
+void PutChunk(std::vector<uint8_t> &out, const char *type, const uint8_t *data, size_t size) {
+	PutU32(out, uint32_t(size));
+	auto start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data, data + size);
+	PutU32(out, CRC(&out[start], size + 4) ^ 0xffffffffu);
+}
+
+//
+struct BitWriter {
+	std::vector<uint8_t> &out;
+	uint32_t bits{0};
+	int count{0};
+
+	void Put(uint32_t value, int n) { // LSB first
+		bits |= value << count;
+		count += n;
+		while (count >= 8) {
+			out.push_back(uint8_t(bits));
+			bits >>= 8;
+			count -= 8;
+		}
+	}
+
+	void PutHuffman(uint32_t code, int n) { // Huffman codes go MSB first
+		uint32_t reversed = 0;
+		for (int i = 0; i < n; ++i)
+			reversed |= ((code >> i) & 1) << (n - 1 - i);
+		Put(reversed, n);
+	}
+
+	void Flush() {
+		if (count)
+			out.push_back(uint8_t(bits));
+		bits = 0;
+		count = 0;
+	}
+};
+
+void PutLiteral(BitWriter &w, int v) { // fixed Huffman literal/length codes
+	if (v < 144)
+		w.PutHuffman(0x30 + v, 8);
+	else if (v < 256)
+		w.PutHuffman(0x190 + v - 144, 9);
+	else if (v < 280)
+		w.PutHuffman(v - 256, 7);
+	else
+		w.PutHuffman(0xc0 + v - 280, 8);
+}
+
+const uint16_t length_base[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t length_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t dist_base[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const uint8_t dist_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+void PutMatch(BitWriter &w, int length, int dist) {
+	int l = 28;
+	while (length_base[l] > length)
+		--l;
+	PutLiteral(w, 257 + l);
+	w.Put(length - length_base[l], length_extra[l]);
+
+	int d = 29;
+	while (dist_base[d] > dist)
+		--d;
+	w.PutHuffman(d, 5);
+	w.Put(dist - dist_base[d], dist_extra[d]);
+}
+
+constexpr int window_size = 32768, max_match = 258, hash_bits = 15;
+
+void Deflate(const uint8_t *data, size_t size, std::vector<uint8_t> &out) {
+	BitWriter w{out};
+	w.Put(1, 1); // final block
+	w.Put(1, 2); // fixed Huffman codes
+
+	std::vector<int32_t> head(size_t(1) << hash_bits, -1);
+	auto hash = [data](size_t i) { return ((uint32_t(data[i]) << 16 | uint32_t(data[i + 1]) << 8 | data[i + 2]) * 2654435761u) >> (32 - hash_bits); };
+
+	size_t i = 0;
+	while (i < size) {
+		int best_len = 0, best_dist = 0;
+
+		if (i + 3 <= size) {
+			auto h = hash(i);
+			auto candidate = head[h];
+			head[h] = int32_t(i);
+
+			if (candidate >= 0 && i - candidate <= window_size) {
+				auto limit = int(std::min<size_t>(max_match, size - i));
+				int len = 0;
+				while (len < limit && data[candidate + len] == data[i + len])
+					++len;
+				if (len >= 3) {
+					best_len = len;
+					best_dist = int(i - candidate);
+				}
+			}
+		}
+
+		if (best_len) {
+			PutMatch(w, best_len, best_dist);
+			for (size_t j = i + 1; j < i + best_len && j + 3 <= size; ++j) // keep the hash table fresh over the match
+				head[hash(j)] = int32_t(j);
+			i += best_len;
+		} else {
+			PutLiteral(w, data[i]);
+			++i;
+		}
+	}
+
+	PutLiteral(w, 256); // end of block
+	w.Flush();
+}
+} // namespace
+
+void EncodePNG(const uint8_t *rgba, int w, int h, int stride, bool bottom_up, std::vector<uint8_t> &png) {
+	auto row_bytes = size_t(w) * 4;
+
+	// filtered rows, each prefixed with its filter type
+	std::vector<uint8_t> raw((row_bytes + 1) * h), sub(row_bytes), up(row_bytes);
+	const uint8_t *prev = nullptr;
+
+	for (int y = 0; y < h; ++y) {
+		auto row = rgba + size_t(bottom_up ? h - 1 - y : y) * stride;
+
+		unsigned sub_cost = 0, up_cost = 0;
+		for (size_t x = 0; x < row_bytes; ++x) {
+			sub[x] = uint8_t(row[x] - (x >= 4 ? row[x - 4] : 0));
+			up[x] = uint8_t(row[x] - (prev ? prev[x] : 0));
+			sub_cost += std::abs(int(int8_t(sub[x])));
+			up_cost += std::abs(int(int8_t(up[x])));
+		}
+
+		auto dst = &raw[y * (row_bytes + 1)];
+		dst[0] = up_cost < sub_cost ? 2 : 1;
+		memcpy(dst + 1, up_cost < sub_cost ? up.data() : sub.data(), row_bytes);
+		prev = row;
+	}
+
+	std::vector<uint8_t> zlib = {0x78, 0x01};
+	zlib.reserve(raw.size() / 4);
+	Deflate(raw.data(), raw.size(), zlib);
+	PutU32(zlib, Adler32(raw.data(), raw.size()));
+
+	static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+	png.assign(signature, signature + 8);
+
+	uint8_t ihdr[13] = {};
+	ihdr[0] = uint8_t(w >> 24), ihdr[1] = uint8_t(w >> 16), ihdr[2] = uint8_t(w >> 8), ihdr[3] = uint8_t(w);
+	ihdr[4] = uint8_t(h >> 24), ihdr[5] = uint8_t(h >> 16), ihdr[6] = uint8_t(h >> 8), ihdr[7] = uint8_t(h);
+	ihdr[8] = 8; // bits per channel
+	ihdr[9] = 6; // RGBA
+
+	PutChunk(png, "IHDR", ihdr, sizeof(ihdr));
+	PutChunk(png, "IDAT", zlib.data(), zlib.size());
+	PutChunk(png, "IEND", nullptr, 0);
+}
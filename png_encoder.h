@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Minimal PNG encoder for frame captures: 8 bit RGBA, each row filtered with
+// Sub or Up (the smaller one), deflated with LZ77 and the fixed Huffman codes.
+// Game frames are mostly flat areas and sprites, which this compresses well
+// without the cost of building dynamic Huffman tables.
+//
+// No engine dependency.
+
+/// Encode w x h RGBA pixels, rows stride bytes apart. bottom_up when the first row is the bottom one (OpenGL convention).
+void EncodePNG(const uint8_t *rgba, int w, int h, int stride, bool bottom_up, std::vector<uint8_t> &png);
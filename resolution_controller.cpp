@@ -0,0 +1,189 @@
+#include "resolution_controller.h"
+
+#include <algorithm>
+
+const std::array<ResolutionLevel, ResolutionController::level_count> ResolutionController::levels = {{
+	{1.f, 4},
+	{1.f, 2},
+	{0.85f, 2},
+	{0.75f, 1},
+	{0.6f, 1},
+	{0.5f, 1},
+}};
+
+namespace {
+constexpr float over_budget = 1.2f; // a missed vsync doubles the frame time, leave room for jitter
+constexpr float under_budget = 1.05f;
+
+constexpr int min_raise_delay = 3 * 60, max_raise_delay = 60 * 60; // frames
+constexpr int probe_duration = 4 * ResolutionController::window_size; // a drop this soon after climbing means the climb failed
+} // namespace
+
+ResolutionController::ResolutionController(float target_ms_) : target_ms(target_ms_), raise_delay(min_raise_delay) {}
+
+void ResolutionController::Reset() {
+	window_count = window_next = 0;
+	level = 0;
+	frames_since_change = stable_frames = 0;
+	raise_delay = min_raise_delay;
+	probing = false;
+}
+
+float ResolutionController::GetRecentMs() const {
+	if (!window_count)
+		return 0.f;
+
+	std::array<float, window_size> sorted;
+	std::copy(window.begin(), window.begin() + window_count, sorted.begin());
+
+	auto p90 = sorted.begin() + (window_count * 9) / 10;
+	std::nth_element(sorted.begin(), p90, sorted.begin() + window_count);
+	return *p90;
+}
+
+void ResolutionController::GetTargetSize(int idx, int full_w, int full_h, int &w, int &h) {
+	auto scale = levels[idx].scale;
+	w = std::max(int(full_w * scale) & ~1, 2);
+	h = std::max(int(full_h * scale) & ~1, 2);
+}
+
+int ResolutionController::Update(float frame_ms) {
+	window[window_next] = frame_ms;
+	window_next = (window_next + 1) % window_size;
+	window_count = std::min(window_count + 1, window_size);
+
+	++frames_since_change;
+	if (probing && frames_since_change > probe_duration) { // the climb held, next ones can come sooner
+		probing = false;
+		raise_delay = min_raise_delay;
+	}
+
+	if (window_count < window_size)
+		return level; // not enough frames at this level yet, the percentile would be the max
+
+	auto recent = GetRecentMs();
+
+	if (recent > target_ms * over_budget) {
+		stable_frames = 0;
+
+		if (level < level_count - 1) {
+			if (probing) {
+				raise_delay = std::min(raise_delay * 2, max_raise_delay);
+				probing = false;
+			}
+
+			++level;
+			frames_since_change = 0;
+			window_count = window_next = 0; // judge the new level on its own frames
+		}
+	} else if (recent <= target_ms * under_budget) {
+		if (++stable_frames >= raise_delay && level > 0) {
+			--level;
+			probing = true;
+			frames_since_change = stable_frames = 0;
+			window_count = window_next = 0;
+		}
+	} else {
+		stable_frames = 0;
+	}
+
+	return level;
+}
+
+//
+namespace {
+struct SyntheticGPU { // frame time model: fixed cost plus fill cost, optionally vsynced
+	float cpu_ms, fill_ms; // fill_ms at full resolution and 4x MSAA
+	bool vsync;
+	uint32_t rng{1};
+
+	float FrameMs(int level, float target_ms) {
+		static const float msaa_cost[] = {0.f, 0.65f, 0.8f, 0.f, 1.f};
+		auto &l = ResolutionController::GetLevel(level);
+
+		rng ^= rng << 13; // +-5% jitter
+		rng ^= rng >> 17;
+		rng ^= rng << 5;
+		auto jitter = 0.95f + 0.1f * float(rng >> 8) / 16777216.f;
+
+		auto ms = (cpu_ms + fill_ms * l.scale * l.scale * msaa_cost[l.msaa]) * jitter;
+		return vsync ? std::max(1.f, float(int(ms / target_ms + 0.999f))) * target_ms : ms;
+	}
+};
+
+struct TraceStats {
+	int changes{0}, over_budget{0}, min_level{ResolutionController::level_count}, max_level{-1};
+};
+
+TraceStats RunTrace(ResolutionController &ctrl, SyntheticGPU &gpu, int frame_count, int hitch_period = 0) {
+	TraceStats stats;
+
+	for (int i = 0; i < frame_count; ++i) {
+		auto level = ctrl.GetLevelIndex();
+		auto ms = gpu.FrameMs(level, ctrl.GetTargetMs());
+		if (hitch_period && (i % hitch_period) < 2)
+			ms = 50.f; // two frame hitch (loading, OS)
+
+		if (ms > ctrl.GetTargetMs() * 1.2f)
+			++stats.over_budget;
+		if (ctrl.Update(ms) != level)
+			++stats.changes;
+
+		stats.min_level = std::min(stats.min_level, ctrl.GetLevelIndex());
+		stats.max_level = std::max(stats.max_level, ctrl.GetLevelIndex());
+	}
+	return stats;
+}
+} // namespace
+
+const char *ResolutionControllerCheck() {
+	constexpr int minute = 60 * 60;
+
+	{
+		ResolutionController ctrl;
+		SyntheticGPU gpu{4.f, 8.f, true};
+		if (RunTrace(ctrl, gpu, minute).max_level != 0)
+			return "light load left the full quality level";
+	}
+
+	{
+		ResolutionController ctrl;
+		SyntheticGPU gpu{4.f, 8.f, true};
+		if (RunTrace(ctrl, gpu, minute, 120).max_level != 0)
+			return "two frame hitches lowered the quality";
+	}
+
+	{
+		ResolutionController ctrl;
+		SyntheticGPU gpu{4.f, 26.f, false};
+		RunTrace(ctrl, gpu, minute);
+		auto settled = RunTrace(ctrl, gpu, minute);
+		if (settled.over_budget > minute / 50)
+			return "overload was not brought back under budget";
+		if (ctrl.GetLevelIndex() == ResolutionController::level_count - 1)
+			return "overload dropped to the lowest level while a higher one fits";
+	}
+
+	{
+		ResolutionController ctrl;
+		SyntheticGPU gpu{4.f, 26.f, true};
+		RunTrace(ctrl, gpu, 20 * 60);
+		gpu.fill_ms = 8.f; // load goes away
+		RunTrace(ctrl, gpu, 2 * minute);
+		if (ctrl.GetLevelIndex() != 0)
+			return "quality did not climb back once the load went away";
+	}
+
+	{
+		ResolutionController ctrl;
+		SyntheticGPU gpu{4.f, 13.5f, true}; // full quality a bit over budget, 2x MSAA fits
+		RunTrace(ctrl, gpu, minute);
+		auto stats = RunTrace(ctrl, gpu, 5 * minute);
+		if (stats.changes > 10)
+			return "quality oscillates around the budget";
+		if (stats.over_budget > 5 * minute / 50)
+			return "too many frames over budget around the budget";
+	}
+
+	return nullptr;
+}
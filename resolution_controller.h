@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Picks the internal render resolution and MSAA level from recent frame times.
+// The controller only sees numbers, it is driven by the renderer in the game
+// and by synthetic or recorded frame time traces in -scale-check/-scale-trace.
+//
+// Levels go from full quality (0) to the cheapest. Under load the controller
+// drops a level as soon as the recent frames go over budget. It only climbs
+// back after a long stable period, and waits twice as long before the next
+// attempt when climbing immediately put it over budget again (eg. a vsynced
+// game sitting just above the cost of the higher level).
+struct ResolutionLevel {
+	float scale; // of the 720x1280 playfield
+	int msaa; // 1, 2 or 4
+};
+
+class ResolutionController {
+public:
+	static constexpr int level_count = 6;
+	static constexpr int window_size = 30; // frames
+
+	explicit ResolutionController(float target_ms = 1000.f / 60.f);
+
+	/// Feed the duration of the last frame, returns the level to render the next one at.
+	int Update(float frame_ms);
+	void Reset();
+
+	int GetLevelIndex() const { return level; }
+	const ResolutionLevel &GetLevel() const { return levels[level]; }
+	static const ResolutionLevel &GetLevel(int idx) { return levels[idx]; }
+
+	/// Size of the render target for a level, even so that the upscale stays centered.
+	static void GetTargetSize(int idx, int full_w, int full_h, int &w, int &h);
+
+	float GetTargetMs() const { return target_ms; }
+	/// 90th percentile of the frame times in the window.
+	float GetRecentMs() const;
+
+private:
+	static const std::array<ResolutionLevel, level_count> levels;
+
+	float target_ms;
+
+	std::array<float, window_size> window;
+	int window_count{0}, window_next{0};
+
+	int level{0};
+	int frames_since_change{0}, stable_frames{0};
+	int raise_delay; // frames under budget before climbing
+	bool probing{false}; // climbed recently, a drop now doubles raise_delay
+};
+
+/// Run the controller against synthetic frame time traces (steady load, overload, hitches,
+/// load going away, vsync just above budget), returns nullptr on success or what failed.
+const char *ResolutionControllerCheck();
@@ -0,0 +1,317 @@
+#include "soft_mixer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFT_MIXER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+void MixSamplesScalar(float *acc, const float *src, int count, float gain) {
+	for (int i = 0; i < count; ++i)
+		acc[i] += src[i] * gain;
+}
+
+void MixSamples(float *acc, const float *src, int count, float gain) {
+#if SOFT_MIXER_SSE2
+	auto g = _mm_set1_ps(gain);
+
+	int i = 0;
+	for (; i + 8 <= count; i += 8) { // two registers per iteration to hide the add latency
+		auto a0 = _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(_mm_loadu_ps(src + i), g));
+		auto a1 = _mm_add_ps(_mm_loadu_ps(acc + i + 4), _mm_mul_ps(_mm_loadu_ps(src + i + 4), g));
+		_mm_storeu_ps(acc + i, a0);
+		_mm_storeu_ps(acc + i + 4, a1);
+	}
+	MixSamplesScalar(acc + i, src + i, count - i, gain);
+#else
+	MixSamplesScalar(acc, src, count, gain);
+#endif
+}
+
+//
+PcmResampler::PcmResampler(int channels_, int rate, int mixer_rate) : channels(std::min(std::max(channels_, 1), soft_mixer_channels)), step(double(rate) / double(mixer_rate)) {}
+
+int PcmResampler::Process(const int16_t *in, int in_frames, float *out, int max_out, int &consumed) {
+	consumed = 0;
+
+	auto load = [this, in](int frame, float *dst) {
+		for (int c = 0; c < soft_mixer_channels; ++c)
+			dst[c] = float(in[frame * channels + std::min(c, channels - 1)]) * (1.f / 32768.f);
+	};
+
+	if (!primed) {
+		if (!in_frames)
+			return 0;
+		load(consumed++, next);
+		pos = 1.0; // the first output frame is the first source frame
+		primed = true;
+	}
+
+	int n = 0;
+	while (n < max_out) {
+		while (pos >= 1.0) { // move to the source frames around the output one
+			if (consumed == in_frames)
+				return n;
+			std::copy(next, next + soft_mixer_channels, prev);
+			load(consumed++, next);
+			pos -= 1.0;
+		}
+
+		auto t = float(pos);
+		for (int c = 0; c < soft_mixer_channels; ++c)
+			out[n * soft_mixer_channels + c] = prev[c] + (next[c] - prev[c]) * t;
+
+		++n;
+		pos += step;
+	}
+	return n;
+}
+
+void PcmFromInt16(PcmSound &sound, const int16_t *samples, size_t frame_count, int channels, int rate, int mixer_rate) {
+	PcmResampler resampler(channels, rate, mixer_rate);
+
+	auto max_out = int(std::ceil(double(frame_count) / resampler.step)) + 2;
+	sound.samples.resize(size_t(max_out) * soft_mixer_channels);
+
+	int consumed;
+	sound.frame_count = resampler.Process(samples, int(frame_count), sound.samples.data(), max_out, consumed);
+	sound.samples.resize(size_t(sound.frame_count) * soft_mixer_channels);
+}
+
+//
+MusicStream::MusicStream(DecodeFn decode, void *user_, int channels, int rate, int mixer_rate, int buffer_frames)
+	: decode_fn(decode), user(user_), resampler(channels, rate, mixer_rate) {
+	ring_frames = 1024;
+	while (ring_frames < uint32_t(buffer_frames))
+		ring_frames *= 2; // counters wrap at 2^32, keep the ring a divisor of it
+	ring.resize(size_t(ring_frames) * soft_mixer_channels);
+}
+
+bool MusicStream::Start() {
+	if (thread.joinable())
+		return false;
+
+	quit = false;
+	thread = std::thread([this]() { Run(); });
+	return true;
+}
+
+void MusicStream::Stop() {
+	if (!thread.joinable())
+		return;
+
+	quit = true;
+	thread.join();
+}
+
+void MusicStream::Run() {
+	constexpr int block_frames = 4096;
+	std::vector<float> block(block_frames * soft_mixer_channels);
+
+	const int16_t *samples = nullptr;
+	size_t chunk_frames = 0, used = 0;
+
+	while (!quit) {
+		if (used == chunk_frames) {
+			chunk_frames = decode_fn(samples, user);
+			used = 0;
+			if (!chunk_frames) {
+				finished = true;
+				break;
+			}
+		}
+
+		auto t = tail.load(std::memory_order_relaxed);
+		auto free_frames = ring_frames - (t - head.load(std::memory_order_acquire));
+		if (free_frames < block_frames) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(5)); // a 32k frame ring holds 0.7s
+			continue;
+		}
+
+		int consumed;
+		auto n = resampler.Process(samples + used * resampler.channels, int(chunk_frames - used), block.data(), block_frames, consumed);
+		used += consumed;
+
+		for (int i = 0; i < n; ++i) {
+			auto dst = &ring[size_t((t + i) & (ring_frames - 1)) * soft_mixer_channels];
+			dst[0] = block[i * soft_mixer_channels];
+			dst[1] = block[i * soft_mixer_channels + 1];
+		}
+		tail.store(t + n, std::memory_order_release);
+	}
+}
+
+int MusicStream::Read(float *out, int frame_count) {
+	auto h = head.load(std::memory_order_relaxed);
+	auto available = tail.load(std::memory_order_acquire) - h;
+
+	auto n = int(std::min<uint32_t>(available, uint32_t(frame_count)));
+	for (int i = 0; i < n; ++i) {
+		auto src = &ring[size_t((h + i) & (ring_frames - 1)) * soft_mixer_channels];
+		out[i * soft_mixer_channels] = src[0];
+		out[i * soft_mixer_channels + 1] = src[1];
+	}
+	head.store(h + n, std::memory_order_release);
+
+	if (n < frame_count && !finished)
+		++underrun_count;
+	return n;
+}
+
+bool MusicStream::WaitForFrames(int frame_count, int timeout_ms) {
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+	while (tail.load(std::memory_order_acquire) - head.load(std::memory_order_relaxed) < uint32_t(frame_count) && !finished) {
+		if (std::chrono::steady_clock::now() > deadline)
+			return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+//
+SoftMixer::SoftMixer(int rate_, int voice_count) : rate(rate_), voices(std::max(voice_count, 1)) {}
+
+int SoftMixer::Start(const PcmSound &sound, float gain, bool loop) {
+	if (!sound.frame_count)
+		return -1;
+
+	int idx = 0;
+	for (int i = 0; i < int(voices.size()); ++i) {
+		if (!voices[i].sound) {
+			idx = i;
+			break;
+		}
+		if (voices[i].start < voices[idx].start)
+			idx = i; // all busy so far, replace the oldest
+	}
+
+	auto &voice = voices[idx];
+	voice.sound = &sound;
+	voice.pos = 0;
+	voice.gain = gain;
+	voice.loop = loop;
+	voice.start = ++start_count;
+	return idx;
+}
+
+void SoftMixer::StopAll() {
+	for (auto &voice : voices)
+		voice.sound = nullptr;
+}
+
+int SoftMixer::GetActiveVoiceCount() const {
+	int count = 0;
+	for (auto &voice : voices)
+		if (voice.sound)
+			++count;
+	return count;
+}
+
+void SoftMixer::Mix(int16_t *out, int frame_count) {
+	auto sample_count = frame_count * soft_mixer_channels;
+	if (int(acc.size()) < sample_count) {
+		acc.resize(sample_count);
+		music_buffer.resize(sample_count);
+	}
+	std::fill(acc.begin(), acc.begin() + sample_count, 0.f);
+
+	for (auto &voice : voices) {
+		for (int done = 0; voice.sound && done < frame_count;) {
+			auto count = std::min(frame_count - done, voice.sound->frame_count - voice.pos);
+			MixSamples(&acc[done * soft_mixer_channels], &voice.sound->samples[size_t(voice.pos) * soft_mixer_channels], count * soft_mixer_channels, voice.gain);
+
+			done += count;
+			voice.pos += count;
+			if (voice.pos == voice.sound->frame_count) {
+				if (voice.loop)
+					voice.pos = 0;
+				else
+					voice.sound = nullptr;
+			}
+		}
+	}
+
+	if (music) {
+		auto n = music->Read(music_buffer.data(), frame_count);
+		MixSamples(acc.data(), music_buffer.data(), n * soft_mixer_channels, music_gain);
+	}
+
+	// to 16 bit with saturation
+	int i = 0;
+#if SOFT_MIXER_SSE2
+	auto scale = _mm_set1_ps(32767.f), one = _mm_set1_ps(1.f), sign = _mm_set1_ps(-0.f);
+	for (; i + 8 <= sample_count; i += 8) {
+		auto a = _mm_loadu_ps(&acc[i]), b = _mm_loadu_ps(&acc[i + 4]);
+
+		auto clipped = _mm_movemask_ps(_mm_cmpgt_ps(_mm_andnot_ps(sign, a), one)) | (_mm_movemask_ps(_mm_cmpgt_ps(_mm_andnot_ps(sign, b), one)) << 4);
+		for (; clipped; clipped &= clipped - 1)
+			++clip_count;
+
+		auto packed = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(a, scale)), _mm_cvtps_epi32(_mm_mul_ps(b, scale)));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), packed);
+	}
+#endif
+	for (; i < sample_count; ++i) {
+		auto v = acc[i];
+		if (std::fabs(v) > 1.f) {
+			++clip_count;
+			v = v > 0.f ? 1.f : -1.f;
+		}
+		out[i] = int16_t(std::lrint(v * 32767.f));
+	}
+}
+
+//
+namespace {
+void WriteU32(uint8_t *p, uint32_t v) {
+	for (int i = 0; i < 4; ++i)
+		p[i] = uint8_t(v >> (8 * i));
+}
+} // namespace
+
+bool WavWriter::Open(const char *path, int rate) {
+	Close();
+
+	file = fopen(path, "wb");
+	if (!file)
+		return false;
+
+	uint8_t header[44] = {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ', 16, 0, 0, 0, 1, 0, soft_mixer_channels, 0};
+	WriteU32(header + 24, uint32_t(rate));
+	WriteU32(header + 28, uint32_t(rate) * soft_mixer_channels * 2);
+	header[32] = soft_mixer_channels * 2; // block align
+	header[34] = 16; // bits per sample
+	memcpy(header + 36, "data", 4);
+
+	data_bytes = 0;
+	return fwrite(header, sizeof(header), 1, file) == 1;
+}
+
+void WavWriter::Write(const int16_t *samples, int frame_count) {
+	if (!file)
+		return;
+
+	// samples are little endian on every platform we ship
+	data_bytes += uint32_t(fwrite(samples, sizeof(int16_t) * soft_mixer_channels, frame_count, file) * sizeof(int16_t) * soft_mixer_channels);
+}
+
+void WavWriter::Close() {
+	if (!file)
+		return;
+
+	uint8_t size[4];
+	WriteU32(size, 36 + data_bytes);
+	fseek(file, 4, SEEK_SET);
+	fwrite(size, 4, 1, file);
+
+	WriteU32(size, data_bytes);
+	fseek(file, 40, SEEK_SET);
+	fwrite(size, 4, 1, file);
+
+	fclose(file);
+	file = nullptr;
+}
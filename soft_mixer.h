@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Software SFX mixer. Sounds are decoded once at load to float stereo at the
+// mixer rate, so mixing a voice is a multiply-add over its samples, done 4
+// samples at a time with SSE2. Music is decoded and resampled on a background
+// thread into a ring buffer the mixer reads from.
+//
+// The mixer only produces samples: the caller hands them to a sink, eg. a WAV
+// file or nothing at all for the headless runs (-audio-out, -bench-mixer).
+// No engine dependency: decoding goes through callbacks.
+constexpr int soft_mixer_channels = 2;
+
+struct PcmSound {
+	std::vector<float> samples; // interleaved stereo at the mixer rate
+	int frame_count{0};
+};
+
+/// Convert 16 bit PCM to a sound at the mixer rate, mono is played on both channels.
+void PcmFromInt16(PcmSound &sound, const int16_t *samples, size_t frame_count, int channels, int rate, int mixer_rate);
+
+/// acc[i] += src[i] * gain over count samples.
+void MixSamples(float *acc, const float *src, int count, float gain);
+void MixSamplesScalar(float *acc, const float *src, int count, float gain);
+
+// linear resampler keeping its position across chunks
+struct PcmResampler {
+	PcmResampler(int channels, int rate, int mixer_rate);
+
+	/// Resample up to max_out frames of in, returns the frames written, consumed receives the frames of in used.
+	int Process(const int16_t *in, int in_frames, float *out, int max_out, int &consumed);
+
+	int channels;
+	double step, pos{0}; // in source frames, pos relative to the previous frame
+	float prev[soft_mixer_channels]{}, next[soft_mixer_channels]{};
+	bool primed{false};
+};
+
+class MusicStream {
+public:
+	/// Point samples to the next chunk of 16 bit PCM, valid until the next call, return its frame count, 0 at the end.
+	typedef size_t (*DecodeFn)(const int16_t *&samples, void *user);
+
+	MusicStream(DecodeFn decode, void *user, int channels, int rate, int mixer_rate, int buffer_frames = 32768);
+	~MusicStream() { Stop(); }
+
+	bool Start();
+	void Stop();
+
+	/// Read decoded frames, returns the count read (fewer on underrun or at the end of the stream).
+	int Read(float *out, int frame_count);
+
+	/// Wait until frame_count frames are buffered or the stream ended, for offline mixing faster than real time.
+	bool WaitForFrames(int frame_count, int timeout_ms = 1000);
+
+	bool IsFinished() const { return finished && head == tail; }
+	uint64_t GetUnderrunCount() const { return underrun_count; }
+
+private:
+	void Run();
+
+	DecodeFn decode_fn;
+	void *user;
+	PcmResampler resampler;
+
+	std::vector<float> ring; // stereo frames, single producer, single consumer
+	uint32_t ring_frames;
+	std::atomic<uint32_t> head{0}, tail{0}; // in frames
+
+	std::atomic<bool> quit{false}, finished{false};
+	uint64_t underrun_count{0};
+	std::thread thread;
+};
+
+class SoftMixer {
+public:
+	explicit SoftMixer(int rate = 44100, int voice_count = 32);
+
+	/// Start a voice, the oldest one is replaced when all are busy. Returns the voice index.
+	int Start(const PcmSound &sound, float gain = 1.f, bool loop = false);
+	void StopAll();
+
+	void SetMusic(MusicStream *music, float gain = 1.f) { this->music = music; music_gain = gain; }
+
+	/// Mix frame_count interleaved stereo frames.
+	void Mix(int16_t *out, int frame_count);
+
+	int GetRate() const { return rate; }
+	int GetActiveVoiceCount() const;
+	uint64_t GetStartCount() const { return start_count; }
+	uint64_t GetClipCount() const { return clip_count; }
+
+private:
+	struct Voice {
+		const PcmSound *sound{nullptr};
+		int pos{0}; // frame
+		float gain{1};
+		bool loop{false};
+		uint64_t start{0}; // start order, to pick the voice to replace
+	};
+
+	int rate;
+	std::vector<Voice> voices;
+	std::vector<float> acc, music_buffer;
+
+	MusicStream *music{nullptr};
+	float music_gain{1};
+
+	uint64_t start_count{0}, clip_count{0};
+};
+
+// 16 bit stereo WAV writer, the header is completed on close
+class WavWriter {
+public:
+	~WavWriter() { Close(); }
+
+	bool Open(const char *path, int rate);
+	void Write(const int16_t *samples, int frame_count);
+	void Close();
+
+private:
+	FILE *file{nullptr};
+	uint32_t data_bytes{0};
+};
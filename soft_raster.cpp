@@ -0,0 +1,104 @@
+#include "soft_raster.h"
+
+#include <algorithm>
+#include <cmath>
+
+SoftRaster::SoftRaster(int w_, int h_) : w(std::max(w_, 1)), h(std::max(h_, 1)), pixels(size_t(w) * h * 4, 0) {}
+
+void SoftRaster::Clear(const SoftColor &color) {
+	uint8_t c[4] = {uint8_t(std::lrint(std::min(std::max(color.r, 0.f), 1.f) * 255.f)), uint8_t(std::lrint(std::min(std::max(color.g, 0.f), 1.f) * 255.f)),
+		uint8_t(std::lrint(std::min(std::max(color.b, 0.f), 1.f) * 255.f)), uint8_t(std::lrint(std::min(std::max(color.a, 0.f), 1.f) * 255.f))};
+
+	for (size_t i = 0; i < pixels.size(); i += 4)
+		std::copy(c, c + 4, &pixels[i]);
+}
+
+void SoftRaster::Blend(int x, int y, float r, float g, float b, float a) {
+	if (a <= 0.f)
+		return;
+	a = std::min(a, 1.f);
+
+	auto p = &pixels[(size_t(y) * w + x) * 4];
+	auto mix = [a](uint8_t dst, float src) { return uint8_t(std::lrint(std::min(std::max(src * 255.f * a + float(dst) * (1.f - a), 0.f), 255.f))); };
+
+	p[0] = mix(p[0], r);
+	p[1] = mix(p[1], g);
+	p[2] = mix(p[2], b);
+	p[3] = uint8_t(std::lrint(std::min(a * 255.f + float(p[3]) * (1.f - a), 255.f)));
+}
+
+void SoftRaster::Line(float sx, float sy, float ex, float ey, const SoftColor &s_color, const SoftColor &e_color) {
+	auto steps = int(std::ceil(std::max(std::fabs(ex - sx), std::fabs(ey - sy))));
+	steps = std::max(steps, 1);
+
+	for (int i = 0; i <= steps; ++i) {
+		auto t = float(i) / float(steps);
+		auto x = int(std::floor(sx + (ex - sx) * t)), y = int(std::floor(sy + (ey - sy) * t));
+		if (x < 0 || y < 0 || x >= w || y >= h)
+			continue;
+
+		Blend(x, y, s_color.r + (e_color.r - s_color.r) * t, s_color.g + (e_color.g - s_color.g) * t, s_color.b + (e_color.b - s_color.b) * t, s_color.a + (e_color.a - s_color.a) * t);
+	}
+}
+
+void SoftRaster::Triangle(const float *xy, const SoftColor *colors) { RasterTriangle(xy, colors, nullptr, nullptr); }
+
+void SoftRaster::TexturedQuad(const float *xy, const SoftImage &image, const SoftColor &color) {
+	if (!image.w || !image.h)
+		return;
+
+	// bottom-left, top-left, top-right then bottom-left, top-right, bottom-right
+	const float uv[8] = {0, 0, 0, 1, 1, 1, 1, 0};
+	const SoftColor colors[3] = {color, color, color};
+
+	const float xy0[6] = {xy[0], xy[1], xy[2], xy[3], xy[4], xy[5]}, uv0[6] = {uv[0], uv[1], uv[2], uv[3], uv[4], uv[5]};
+	const float xy1[6] = {xy[0], xy[1], xy[4], xy[5], xy[6], xy[7]}, uv1[6] = {uv[0], uv[1], uv[4], uv[5], uv[6], uv[7]};
+	RasterTriangle(xy0, colors, uv0, &image);
+	RasterTriangle(xy1, colors, uv1, &image);
+}
+
+void SoftRaster::RasterTriangle(const float *xy, const SoftColor *colors, const float *uv, const SoftImage *image) {
+	auto x0 = xy[0], y0 = xy[1], x1 = xy[2], y1 = xy[3], x2 = xy[4], y2 = xy[5];
+
+	auto area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+	if (std::fabs(area) < 1e-6f)
+		return;
+	auto inv_area = 1.f / area;
+
+	auto min_x = std::max(int(std::floor(std::min({x0, x1, x2}))), 0), max_x = std::min(int(std::ceil(std::max({x0, x1, x2}))), w - 1);
+	auto min_y = std::max(int(std::floor(std::min({y0, y1, y2}))), 0), max_y = std::min(int(std::ceil(std::max({y0, y1, y2}))), h - 1);
+
+	for (int y = min_y; y <= max_y; ++y) {
+		auto py = float(y) + 0.5f;
+
+		for (int x = min_x; x <= max_x; ++x) {
+			auto px = float(x) + 0.5f;
+
+			// barycentric weights, the same sign as the area inside the triangle whatever the winding
+			auto b0 = ((x1 - px) * (y2 - py) - (x2 - px) * (y1 - py)) * inv_area;
+			auto b1 = ((x2 - px) * (y0 - py) - (x0 - px) * (y2 - py)) * inv_area;
+			auto b2 = 1.f - b0 - b1;
+			if (b0 < 0.f || b1 < 0.f || b2 < 0.f)
+				continue;
+
+			auto r = colors[0].r * b0 + colors[1].r * b1 + colors[2].r * b2;
+			auto g = colors[0].g * b0 + colors[1].g * b1 + colors[2].g * b2;
+			auto b = colors[0].b * b0 + colors[1].b * b1 + colors[2].b * b2;
+			auto a = colors[0].a * b0 + colors[1].a * b1 + colors[2].a * b2;
+
+			if (image) {
+				auto u = uv[0] * b0 + uv[2] * b1 + uv[4] * b2, v = uv[1] * b0 + uv[3] * b1 + uv[5] * b2;
+				auto tx = std::min(std::max(int(u * image->w), 0), image->w - 1);
+				auto ty = std::min(std::max(int((1.f - v) * image->h), 0), image->h - 1); // v goes up, image rows go down
+
+				auto texel = &image->rgba[(size_t(ty) * image->w + tx) * 4];
+				r *= texel[0] * (1.f / 255.f);
+				g *= texel[1] * (1.f / 255.f);
+				b *= texel[2] * (1.f / 255.f);
+				a *= texel[3] * (1.f / 255.f);
+			}
+
+			Blend(x, y, r, g, b, a);
+		}
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// CPU rasterizer for the 2D draw lists of headless runs (frame capture without
+// render device). It covers the primitives the game draws: lines, flat or
+// gradient triangles and textured quads, alpha blended. Sampling is nearest
+// and there is no antialiasing, captures are for regression checks and replays,
+// not for matching the GPU output pixel for pixel.
+//
+// Coordinates are in pixels with y up, as the 2D view of the game. Row 0 of the
+// pixels is the bottom one.
+// No engine dependency.
+struct SoftColor {
+	float r, g, b, a;
+};
+
+struct SoftImage { // RGBA8, row 0 is the top one as image files store them
+	int w{0}, h{0};
+	std::vector<uint8_t> rgba;
+};
+
+class SoftRaster {
+public:
+	SoftRaster(int w, int h);
+
+	void Clear(const SoftColor &color);
+
+	void Line(float sx, float sy, float ex, float ey, const SoftColor &s_color, const SoftColor &e_color);
+	/// xy holds the 3 vertices.
+	void Triangle(const float *xy, const SoftColor *colors);
+	/// xy holds the corners mapping the image bottom-left, top-left, top-right and bottom-right.
+	void TexturedQuad(const float *xy, const SoftImage &image, const SoftColor &color);
+
+	int GetWidth() const { return w; }
+	int GetHeight() const { return h; }
+	const uint8_t *GetPixels() const { return pixels.data(); }
+
+private:
+	void RasterTriangle(const float *xy, const SoftColor *colors, const float *uv, const SoftImage *image);
+	void Blend(int x, int y, float r, float g, float b, float a);
+
+	int w, h;
+	std::vector<uint8_t> pixels;
+};
@@ -0,0 +1,37 @@
+#include "stress_ramp.h"
+
+#include <algorithm>
+
+StressRamp::StressRamp(float target_ms_, float growth_, int settle_frames_, int measure_frames_)
+	: target_ms(target_ms_), growth(std::max(growth_, 1.01f)), settle_frames(std::max(settle_frames_, 0)), measure_frames(std::max(measure_frames_, 1)) {
+	step_frames.reserve(measure_frames);
+}
+
+bool StressRamp::Update(float frame_ms) {
+	if (done)
+		return false;
+
+	if (frame++ < settle_frames)
+		return false; // spawns and allocations following the level change
+
+	step_frames.push_back(frame_ms);
+	if (int(step_frames.size()) < measure_frames)
+		return false;
+
+	auto p90 = step_frames.begin() + (step_frames.size() * 9) / 10;
+	std::nth_element(step_frames.begin(), p90, step_frames.end());
+	step_ms = *p90;
+
+	if (step_ms > target_ms) {
+		done = true;
+	} else {
+		sustained_level = level;
+		level *= growth;
+		if (level > max_level)
+			done = true;
+	}
+
+	step_frames.clear();
+	frame = 0;
+	return true;
+}
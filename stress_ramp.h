@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+// Load ramp for the stress mode: the load level grows in steps while the frame
+// time holds, the highest level whose step stayed within the target is the
+// sustained load.
+//
+// Each step lets the frame time settle after the level change, then judges the
+// 90th percentile of its remaining frames. The level grows geometrically so that
+// both light and heavy machines reach their limit in a few dozen steps.
+// No engine dependency: the game feeds frame times and scales its load by GetLevel().
+class StressRamp {
+public:
+	explicit StressRamp(float target_ms = 1000.f / 60.f, float growth = 1.25f, int settle_frames = 60, int measure_frames = 240);
+
+	/// Feed the duration of the last frame, returns true when the step ended.
+	bool Update(float frame_ms);
+
+	float GetLevel() const { return level; }
+	/// 0 until a step held.
+	float GetSustainedLevel() const { return sustained_level; }
+	/// 90th percentile of the last completed step.
+	float GetStepMs() const { return step_ms; }
+	float GetTargetMs() const { return target_ms; }
+
+	/// A step went over the target or the level cap was reached.
+	bool IsDone() const { return done; }
+
+	static constexpr float max_level = 10000.f;
+
+private:
+	float target_ms, growth;
+	int settle_frames, measure_frames;
+
+	std::vector<float> step_frames;
+	int frame{0};
+
+	float level{1.f}, sustained_level{0.f}, step_ms{0.f};
+	bool done{false};
+};
@@ -0,0 +1,46 @@
+-- Game flow in Lua on top of the native simulation.
+-- Run with: ggj2018 -lua tako_game.lua
+--
+-- The script must define Frame(), called once per frame. Unlike Lua tables,
+-- the tako player and shoot indices start at 0 as in the game:
+-- SetPlayerAI, SetPlayerInput and GetPlayer take 0 to 3, GetShoot takes 0 to
+-- GetShootCount() - 1.
+tako = require("tako")
+
+state = nil
+
+function Title()
+    tako.Image2D(0, 0, "@data:intro_bg.jpg")
+    tako.Image2D(0, 80, "@data:press_any_button_text.png")
+
+    if tako.AnyButtonPressed() ~= -1 then
+        tako.GameInit()
+        state = Game
+    end
+end
+
+function Game()
+    tako.Tick(tako.GetLastFrameDuration())
+    tako.Draw()
+
+    local human_health, alien_health = tako.GetHealth()
+    if human_health <= 0 or alien_health <= 0 then
+        game_over_text = alien_health <= 0 and "Victory!" or "Game over"
+        state = GameOver
+    end
+end
+
+function GameOver()
+    tako.Image2D(0, 0, "@data:default_screen.jpg")
+    tako.Text2D(360, 640, game_over_text, 96)
+
+    if tako.AnyButtonPressed() ~= -1 then
+        state = Title
+    end
+end
+
+state = Title
+
+function Frame()
+    state()
+end
@@ -0,0 +1,102 @@
+#include "telemetry.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+namespace telemetry {
+TelemetryEvent ring[ring_size];
+std::atomic<uint32_t> head{0}, tail{0};
+std::atomic<uint64_t> dropped{0};
+std::atomic<bool> enabled{false};
+uint8_t instance{0};
+std::chrono::steady_clock::time_point start;
+
+static FILE *file;
+static std::thread flusher;
+static std::mutex mutex; // only guards the flusher wake up, never taken by the producer
+static std::condition_variable cv;
+static bool quit;
+
+static void Drain() {
+	auto t = tail.load(std::memory_order_relaxed), h = head.load(std::memory_order_acquire);
+
+	while (t != h) { // write contiguous spans of the ring
+		auto idx = t & (ring_size - 1);
+		auto count = std::min(h - t, ring_size - idx);
+		fwrite(&ring[idx], sizeof(TelemetryEvent), count, file);
+		t += count;
+		tail.store(t, std::memory_order_release);
+	}
+	fflush(file);
+}
+
+static void Flusher() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!quit) {
+		cv.wait_for(lock, std::chrono::milliseconds(250));
+
+		lock.unlock();
+		Drain();
+		lock.lock();
+	}
+	Drain();
+}
+} // namespace telemetry
+
+using namespace telemetry;
+
+bool TelemetryOpen(const char *path) {
+	if (file)
+		return false;
+
+	file = fopen(path, "ab");
+	if (!file)
+		return false;
+
+	fseek(file, 0, SEEK_END);
+	if (ftell(file) == 0) {
+		TelemetryHeader header{telemetry_magic, telemetry_version, uint32_t(sizeof(TelemetryEvent)), 0};
+		fwrite(&header, sizeof(header), 1, file);
+	}
+
+	start = std::chrono::steady_clock::now();
+	head = tail = 0;
+	dropped = 0;
+	quit = false;
+	flusher = std::thread(Flusher);
+	enabled.store(true, std::memory_order_relaxed);
+
+	TelemetryLog(TelemetrySessionStart);
+	return true;
+}
+
+void TelemetryClose() {
+	if (!file)
+		return;
+
+	enabled.store(false, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	cv.notify_all();
+	flusher.join();
+
+	// written directly, the ring may be the reason for the drops
+	TelemetryEvent end{};
+	end.time_us = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+	end.type = TelemetrySessionEnd;
+	end.instance = instance;
+	end.x = float(dropped.load(std::memory_order_relaxed));
+	fwrite(&end, sizeof(end), 1, file);
+
+	fclose(file);
+	file = nullptr;
+}
+
+void TelemetrySetInstance(int idx) { instance = uint8_t(idx); }
+
+uint64_t TelemetryGetDropCount() { return dropped.load(std::memory_order_relaxed); }
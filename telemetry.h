@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Gameplay telemetry: compact binary events pushed by the game thread into a
+// lock-free ring buffer and appended to a file by a background thread.
+enum TelemetryEventType : uint8_t {
+	TelemetrySessionStart, // time_us restarts from 0
+	TelemetryStateChange, // a: state id
+	TelemetryShotSpawn, // a: first player in the sequence
+	TelemetryShotFire, // a: player, b: sequence index
+	TelemetryShotCapture, // a: player, b: sequence index
+	TelemetryChainBreak, // a: player who failed the transfer, b: human damage
+	TelemetryAlienHit, // a: player, b: alien damage
+	TelemetryAlienMiss, // a: player, b: human damage
+	TelemetryHumanEscape,
+	TelemetryPlayerJoin, // a: player, b: device index
+	TelemetrySessionEnd, // x: events dropped since the log was opened, written on close
+};
+
+#pragma pack(push, 1)
+struct TelemetryEvent {
+	uint64_t time_us; // since the log was opened
+	uint8_t type;
+	uint8_t instance; // game instance, see -instances
+	int8_t a;
+	int16_t b;
+	float x, y;
+};
+#pragma pack(pop)
+
+constexpr uint32_t telemetry_magic = 0x4b415454; // 'TTAK'
+constexpr uint32_t telemetry_version = 2; // 2: instance field
+
+struct TelemetryHeader { // written once at the start of a new file
+	uint32_t magic, version, event_size, reserved;
+};
+
+/// Start logging to path (appending), events pushed before that are dropped.
+bool TelemetryOpen(const char *path);
+/// Flush pending events, stop the flusher thread and end the session with the drop count.
+void TelemetryClose();
+
+/// Tag the events pushed after this with a game instance, producer side like TelemetryLog.
+void TelemetrySetInstance(int instance);
+
+/// Events dropped because the ring buffer was full.
+uint64_t TelemetryGetDropCount();
+
+//
+namespace telemetry {
+constexpr uint32_t ring_size = 1 << 14; // power of 2
+
+extern TelemetryEvent ring[ring_size];
+extern std::atomic<uint32_t> head, tail; // head written by the producer only, tail by the flusher only
+extern std::atomic<uint64_t> dropped;
+extern std::atomic<bool> enabled; // only gates the producer, the events are published by head
+extern uint8_t instance; // producer only
+extern std::chrono::steady_clock::time_point start;
+} // namespace telemetry
+
+/// Single producer, never blocks: the event is dropped when the ring is full.
+inline void TelemetryLog(TelemetryEventType type, int a = 0, int b = 0, float x = 0.f, float y = 0.f) {
+	using namespace telemetry;
+
+	if (!enabled.load(std::memory_order_relaxed))
+		return;
+
+	auto h = head.load(std::memory_order_relaxed);
+	if (h - tail.load(std::memory_order_acquire) >= ring_size) {
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	auto &event = ring[h & (ring_size - 1)];
+	event.time_us = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+	event.type = type;
+	event.instance = instance;
+	event.a = int8_t(a);
+	event.b = int16_t(b);
+	event.x = x;
+	event.y = y;
+
+	head.store(h + 1, std::memory_order_release);
+}
@@ -0,0 +1,129 @@
+#include "texture_budget.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+uint32_t HashPath(const char *path) { // FNV-1a
+	uint32_t hash = 2166136261u;
+	for (; *path; ++path)
+		hash = (hash ^ uint8_t(*path)) * 16777619u;
+	return hash;
+}
+} // namespace
+
+TextureBudget::TextureBudget(LoadFn load, PurgeFn purge) : load_fn(load), purge_fn(purge) {
+	entries.reserve(64);
+	prefetch_queue.reserve(64);
+}
+
+int TextureBudget::Find(const char *path, uint32_t hash) const {
+	for (size_t i = 0; i < entries.size(); ++i)
+		if (entries[i].hash == hash && entries[i].path == path)
+			return int(i);
+	return -1;
+}
+
+int TextureBudget::FindOrAdd(const char *path) {
+	auto hash = HashPath(path);
+
+	auto idx = Find(path, hash);
+	if (idx != -1)
+		return idx;
+
+	entries.emplace_back();
+	entries.back().path = path;
+	entries.back().hash = hash;
+	return int(entries.size() - 1);
+}
+
+void TextureBudget::AddToGroup(int group, const char *const *paths, int count) {
+	for (int i = 0; i < count; ++i)
+		entries[FindOrAdd(paths[i])].groups |= 1u << group;
+}
+
+//
+void TextureBudget::Load(Entry &entry) {
+	if (entry.texture || entry.failed)
+		return;
+
+	size_t bytes = 0;
+	entry.texture = load_fn(entry.path.c_str(), bytes);
+	if (!entry.texture) {
+		entry.failed = true;
+		return;
+	}
+
+	entry.bytes = bytes;
+	resident_bytes += bytes;
+	++resident_count;
+	++load_count;
+}
+
+void TextureBudget::Evict(Entry &entry) {
+	entry.texture.reset();
+	resident_bytes -= entry.bytes;
+	--resident_count;
+	++eviction_count;
+}
+
+bool TextureBudget::EvictOne() {
+	Entry *lru = nullptr;
+	bool lru_current = true;
+
+	for (auto &entry : entries) {
+		if (!entry.texture || entry.last_used >= frame)
+			continue; // not resident or drawn this frame
+
+		bool current = (entry.groups & current_groups) != 0;
+		if (!lru || (lru_current && !current) || (lru_current == current && entry.last_used < lru->last_used)) {
+			lru = &entry;
+			lru_current = current;
+		}
+	}
+
+	if (!lru)
+		return false;
+
+	Evict(*lru);
+	return true;
+}
+
+//
+void TextureBudget::Prefetch(int group) {
+	for (size_t i = 0; i < entries.size(); ++i)
+		if ((entries[i].groups & (1u << group)) && !entries[i].texture && !entries[i].failed)
+			if (std::find(prefetch_queue.begin(), prefetch_queue.end(), int(i)) == prefetch_queue.end())
+				prefetch_queue.push_back(int(i));
+}
+
+void TextureBudget::Touch(const char *path) {
+	auto &entry = entries[FindOrAdd(path)];
+	entry.last_used = frame;
+	Load(entry);
+}
+
+void TextureBudget::Update(int max_loads) {
+	// prefetched textures count as used now so that they survive until their state comes
+	while (max_loads > 0 && !prefetch_queue.empty()) {
+		auto &entry = entries[prefetch_queue.front()];
+		prefetch_queue.erase(prefetch_queue.begin());
+
+		if (entry.texture || entry.failed)
+			continue;
+
+		entry.last_used = frame;
+		Load(entry);
+		--max_loads;
+	}
+
+	bool evicted = false;
+	while (budget && resident_bytes > budget && EvictOne())
+		evicted = true;
+	over_budget = budget && resident_bytes > budget;
+
+	if (evicted && purge_fn)
+		purge_fn();
+
+	++frame;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Texture residency under a memory budget.
+//
+// The budget keeps a reference on each resident texture. Evicting drops that
+// reference and lets the owner purge the engine cache. Textures are grouped by
+// game state (title, menus, gameplay, game over). The state machine hints at
+// the next group so that its textures load ahead of use, a few per frame. When
+// over budget, the least recently used textures go first, but never the ones
+// drawn this frame nor, while others remain, the ones of the current groups
+// (one per game instance on screen).
+//
+// No engine dependency: loading and purging go through the callbacks.
+class TextureBudget {
+public:
+	/// Load a texture, returns null on failure. bytes receives its estimated memory use.
+	typedef std::shared_ptr<void> (*LoadFn)(const char *path, size_t &bytes);
+	/// Called after evictions so that unreferenced textures can be released.
+	typedef void (*PurgeFn)();
+
+	TextureBudget(LoadFn load, PurgeFn purge);
+
+	/// 0 for no limit.
+	void SetBudget(size_t bytes) { budget = bytes; }
+	size_t GetBudget() const { return budget; }
+
+	/// Add paths to a group (0 to 31).
+	void AddToGroup(int group, const char *const *paths, int count);
+
+	/// Groups in use, bit n for group n.
+	void SetCurrentGroups(uint32_t groups) { current_groups = groups; }
+	/// Load the textures of a group over the next frames.
+	void Prefetch(int group);
+
+	/// The texture is drawn this frame, load it now if needed.
+	void Touch(const char *path);
+
+	/// Load up to max_loads prefetched textures then evict down to the budget, call once per frame.
+	void Update(int max_loads = 1);
+
+	size_t GetResidentBytes() const { return resident_bytes; }
+	int GetResidentCount() const { return resident_count; }
+	uint64_t GetEvictionCount() const { return eviction_count; }
+	uint64_t GetLoadCount() const { return load_count; }
+	/// The textures drawn in the last frame alone do not fit the budget.
+	bool IsOverBudget() const { return over_budget; }
+
+private:
+	struct Entry {
+		std::string path;
+		uint32_t hash;
+		uint32_t groups{0};
+		std::shared_ptr<void> texture;
+		size_t bytes{0};
+		uint64_t last_used{0}; // frame
+		bool failed{false}; // do not retry a missing file every frame
+	};
+
+	int Find(const char *path, uint32_t hash) const;
+	int FindOrAdd(const char *path);
+	void Load(Entry &entry);
+	void Evict(Entry &entry);
+	bool EvictOne();
+
+	LoadFn load_fn;
+	PurgeFn purge_fn;
+
+	std::vector<Entry> entries; // a few dozen textures, scanned linearly
+	std::vector<int> prefetch_queue;
+
+	size_t budget{0}, resident_bytes{0};
+	int resident_count{0};
+	uint32_t current_groups{0};
+	uint64_t frame{1}, eviction_count{0}, load_count{0};
+	bool over_budget{false};
+};
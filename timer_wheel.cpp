@@ -0,0 +1,168 @@
+#include "timer_wheel.h"
+
+#include <algorithm>
+
+TimerWheel::TimerWheel(int64_t resolution_, uint32_t slot_count, uint32_t capacity) : resolution(resolution_ > 0 ? resolution_ : 1) {
+	slots.resize(slot_count > 0 ? slot_count : 1, 0);
+
+	nodes.reserve(capacity + 1);
+	nodes.emplace_back();
+	nodes[0].gen = 0;
+
+	free_nodes.reserve(capacity);
+	expired.reserve(capacity);
+}
+
+uint32_t TimerWheel::AllocNode() {
+	uint32_t idx;
+	if (free_nodes.empty()) {
+		idx = uint32_t(nodes.size());
+		nodes.emplace_back();
+		nodes[idx].gen = 0;
+	} else {
+		idx = free_nodes.back();
+		free_nodes.pop_back();
+	}
+
+	nodes[idx].gen++; // odd, pending
+	++pending_count;
+	return idx;
+}
+
+void TimerWheel::Link(uint32_t idx) {
+	auto &node = nodes[idx];
+
+	auto node_tick = std::max(node.deadline / resolution, tick); // Advance revisits the slot of the current tick
+	node.slot = uint32_t(node_tick % int64_t(slots.size()));
+
+	node.prev = 0;
+	node.next = slots[node.slot];
+	if (node.next)
+		nodes[node.next].prev = idx;
+	slots[node.slot] = idx;
+}
+
+void TimerWheel::Unlink(uint32_t idx) {
+	auto &node = nodes[idx];
+	if (node.slot == no_slot)
+		return;
+
+	if (node.prev)
+		nodes[node.prev].next = node.next;
+	else
+		slots[node.slot] = node.next;
+
+	if (node.next)
+		nodes[node.next].prev = node.prev;
+
+	node.slot = no_slot;
+}
+
+void TimerWheel::Release(uint32_t idx) {
+	nodes[idx].gen++; // even, free
+	free_nodes.push_back(idx);
+	--pending_count;
+}
+
+//
+TimerHandle TimerWheel::Schedule(int64_t delay, Callback callback, void *user) {
+	auto idx = AllocNode();
+
+	auto &node = nodes[idx];
+	node.deadline = now + std::max<int64_t>(delay, 0);
+	node.seq = next_seq++;
+	node.callback = callback;
+	node.user = user;
+	node.flag = nullptr;
+
+	Link(idx);
+	return {idx, node.gen};
+}
+
+TimerHandle TimerWheel::SetFlag(int64_t delay, bool *flag) {
+	auto timer = Schedule(delay);
+	nodes[timer.idx].flag = flag;
+	return timer;
+}
+
+void TimerWheel::Reschedule(TimerHandle timer, int64_t delay) {
+	if (!IsPending(timer))
+		return;
+
+	Unlink(timer.idx);
+	nodes[timer.idx].deadline = now + std::max<int64_t>(delay, 0);
+	nodes[timer.idx].seq = next_seq++;
+	Link(timer.idx);
+}
+
+void TimerWheel::Cancel(TimerHandle &timer) {
+	if (IsPending(timer)) {
+		Unlink(timer.idx);
+		Release(timer.idx);
+	}
+	timer = {};
+}
+
+//
+void TimerWheel::Advance(int64_t dt) {
+	now += std::max<int64_t>(dt, 0);
+
+	auto end_tick = now / resolution;
+	auto visit_count = std::min<int64_t>(end_tick - tick + 1, int64_t(slots.size())); // a full turn visits every slot once
+
+	for (int64_t i = 0; i < visit_count; ++i) {
+		auto slot = uint32_t((tick + i) % int64_t(slots.size()));
+
+		for (auto idx = slots[slot]; idx;) {
+			auto next = nodes[idx].next;
+			if (nodes[idx].deadline <= now) {
+				Unlink(idx);
+				expired.push_back({idx, nodes[idx].gen});
+			}
+			idx = next;
+		}
+	}
+	tick = end_tick;
+
+	if (expired.empty())
+		return;
+
+	std::sort(expired.begin(), expired.end(), [this](TimerHandle a, TimerHandle b) {
+		auto &na = nodes[a.idx], &nb = nodes[b.idx];
+		return na.deadline != nb.deadline ? na.deadline < nb.deadline : na.seq < nb.seq;
+	});
+
+	// release before calling so that callbacks can schedule again, possibly reusing the node
+	for (size_t i = 0; i < expired.size(); ++i) {
+		if (!IsPending(expired[i]) || nodes[expired[i].idx].slot != no_slot)
+			continue; // cancelled or rescheduled by a previous callback
+
+		auto idx = expired[i].idx;
+		auto callback = nodes[idx].callback;
+		auto user = nodes[idx].user;
+		auto flag = nodes[idx].flag;
+
+		Release(idx);
+
+		if (flag)
+			*flag = true;
+		if (callback)
+			callback(user);
+	}
+	expired.clear();
+}
+
+void TimerWheel::Clear() {
+	for (auto &head : slots)
+		for (auto idx = head; idx;) {
+			auto next = nodes[idx].next;
+			Release(idx);
+			idx = next;
+		}
+
+	std::fill(slots.begin(), slots.end(), 0);
+
+	for (auto timer : expired) // called from a callback, drop the timers still to fire
+		if (IsPending(timer) && nodes[timer.idx].slot == no_slot)
+			Release(timer.idx);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Handle to a scheduled timer, stays valid but no longer pending once the timer fired or was cancelled.
+struct TimerHandle {
+	uint32_t idx{0}, gen{0};
+};
+
+// Hashed timer wheel with absolute deadlines. Timers are bucketed by deadline
+// tick so that Advance() only visits the slots crossed since the last call:
+// the cost is the number of expired timers plus the few long timers sharing
+// those slots, not the number of scheduled timers.
+//
+// A timer can call a function, raise a flag or do nothing, in which case it is
+// only used for its remaining time (eg. to fade out a message).
+class TimerWheel {
+public:
+	typedef void (*Callback)(void *user);
+
+	TimerWheel(int64_t resolution, uint32_t slot_count = 256, uint32_t capacity = 64);
+
+	int64_t GetNow() const { return now; }
+
+	TimerHandle Schedule(int64_t delay, Callback callback = nullptr, void *user = nullptr);
+	/// Set *flag to true when the timer fires.
+	TimerHandle SetFlag(int64_t delay, bool *flag);
+
+	/// Move a pending timer to a new deadline, does nothing if the timer is not pending.
+	void Reschedule(TimerHandle timer, int64_t delay);
+	void Cancel(TimerHandle &timer);
+
+	bool IsPending(TimerHandle timer) const { return timer.gen && timer.idx < nodes.size() && nodes[timer.idx].gen == timer.gen; }
+	/// Time left before the timer fires, 0 if it is not pending.
+	int64_t GetRemaining(TimerHandle timer) const { return IsPending(timer) ? nodes[timer.idx].deadline - now : 0; }
+
+	size_t GetPendingCount() const { return pending_count; }
+
+	/// Advance the clock and fire the expired timers in deadline order.
+	void Advance(int64_t dt);
+	/// Drop all pending timers without firing them, the clock keeps running.
+	void Clear();
+
+private:
+	struct Node {
+		int64_t deadline;
+		uint64_t seq; // ties on the deadline fire in scheduling order
+		Callback callback;
+		void *user;
+		bool *flag;
+		uint32_t gen; // even when free, odd when pending
+		uint32_t prev, next; // slot list links, 0 is the end of list
+		uint32_t slot; // no_slot once unlinked
+	};
+
+	static constexpr uint32_t no_slot = 0xffffffff;
+
+	uint32_t AllocNode();
+	void Link(uint32_t idx);
+	void Unlink(uint32_t idx);
+	void Release(uint32_t idx);
+
+	int64_t resolution, now{0}, tick{0};
+	uint64_t next_seq{0};
+	size_t pending_count{0};
+
+	std::vector<Node> nodes; // node 0 is unused so that 0 is the null link
+	std::vector<uint32_t> slots, free_nodes;
+	std::vector<TimerHandle> expired; // unlinked, fired unless cancelled by an earlier callback
+};